@@ -0,0 +1,484 @@
+// Raycaster benchmark: renders fixed camera paths on the built-in map and on generated large maps,
+// without a window, and prints one CSV line per map, path and backend. Every run renders the same frames,
+// so the ray counts and steps only change when the code does and the timings can be compared between
+// builds and commits.
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "Engine.h"
+#include "Entities.h"
+#include "Framebuffer.h"
+#include "Lightmap.h"
+#include "Occupancy.h"
+#include "Raycast.h"
+#include "Sight.h"
+#include "Views.h"
+#include "Window.h"
+
+// side of the generated maps in tiles
+const int generated_size = 1024;
+
+// camera moving in a straight line while turning at a constant rate, one step per frame
+struct CameraPath
+{
+    const char *name;
+    sf::Vector2f from;
+    sf::Vector2f to;
+    float angle_from; // view direction in radians, 0 is +x, pi / 2 is +y
+    float angle_to;
+};
+
+struct Scene
+{
+    const char *name;
+    void (*load)();
+    int entities; // scattered over the map
+    CameraPath paths[4];
+};
+
+static void loadWorldMap()
+{
+    loadMap();
+}
+
+// open hall with a pillar every 16 tiles, some of them lamps, and one long walled corridor through it
+static void loadOpenMap()
+{
+    const int size = generated_size;
+    std::string rows(size * size, '.');
+    for (int y = 0; y < size; ++y)
+    {
+        for (int x = 0; x < size; ++x)
+        {
+            char &tile = rows[y * size + x];
+            if (x == 0 || y == 0 || x == size - 1 || y == size - 1)
+                tile = '1';
+            else if (x % 16 >= 7 && x % 16 <= 8 && y % 16 >= 7 && y % 16 <= 8)
+                tile = (x / 16 + y / 16) % 5 == 0 ? '5' : '4';
+            else if ((y == 500 || y == 502) && x >= 100 && x < 900)
+                tile = '1';
+        }
+    }
+    loadMapRows(rows.data(), size, size);
+}
+
+// the inside of worldMap repeated over the whole map, so the copies open into each other
+static void loadTiledMap()
+{
+    const int size = generated_size;
+    const int inside = worldMapWidth - 2;
+    std::string rows(size * size, '1');
+    for (int y = 1; y < size - 1; ++y)
+    {
+        for (int x = 1; x < size - 1; ++x)
+        {
+            rows[y * size + x] = worldMap[(1 + (y - 1) % inside) * worldMapWidth + 1 + (x - 1) % inside];
+        }
+    }
+    loadMapRows(rows.data(), size, size);
+}
+
+// worldMap coordinates in the copy of it at the middle of the tiled map
+static sf::Vector2f tiled(float x, float y)
+{
+    const int offset = 17 * (worldMapWidth - 2);
+    return sf::Vector2f(x + offset, y + offset);
+}
+
+// close enough to a wall for the collision box to touch it
+const float hug = collision_box / 2 + 0.01f;
+const float pi = 3.14159265f;
+
+static const Scene scenes[] = {
+    {"worldMap",
+     loadWorldMap,
+     0,
+     {{"corridor", {13.5f, 1.5f}, {13.5f, 11.5f}, pi / 2, pi / 2},
+      {"hall", {1.5f, 16.5f}, {29.5f, 16.5f}, 0.0f, 0.0f},
+      {"wall", {1 + hug, 12.5f}, {1 + hug, 21.5f}, pi * 3 / 4, pi * 3 / 4},
+      {"spin", {15.5f, 16.5f}, {15.5f, 16.5f}, 0.0f, 2 * pi}}},
+    {"open1024",
+     loadOpenMap,
+     0,
+     {{"corridor", {100.5f, 501.5f}, {899.5f, 501.5f}, 0.0f, 0.0f},
+      {"hall", {100.5f, 300.5f}, {900.5f, 300.5f}, 0.0f, 0.0f},
+      {"wall", {1 + hug, 100.5f}, {1 + hug, 900.5f}, pi * 3 / 4, pi * 3 / 4},
+      {"spin", {520.5f, 300.5f}, {520.5f, 300.5f}, 0.0f, 2 * pi}}},
+    {"tiled1024",
+     loadTiledMap,
+     0,
+     {{"corridor", tiled(13.5f, 1.5f), tiled(13.5f, 11.5f), pi / 2, pi / 2},
+      {"hall", tiled(1.5f, 16.5f), tiled(29.5f, 16.5f), 0.0f, 0.0f},
+      {"wall", tiled(1 + hug, 12.5f), tiled(1 + hug, 21.5f), pi * 3 / 4, pi * 3 / 4},
+      {"spin", tiled(15.5f, 16.5f), tiled(15.5f, 16.5f), 0.0f, 2 * pi}}},
+    {"entities1024",
+     loadOpenMap,
+     10000,
+     {{"corridor", {100.5f, 501.5f}, {899.5f, 501.5f}, 0.0f, 0.0f},
+      {"hall", {100.5f, 300.5f}, {900.5f, 300.5f}, 0.0f, 0.0f},
+      {"wall", {1 + hug, 100.5f}, {1 + hug, 900.5f}, pi * 3 / 4, pi * 3 / 4},
+      {"spin", {520.5f, 300.5f}, {520.5f, 300.5f}, 0.0f, 2 * pi}}},
+};
+
+static void setCamera(const CameraPath &path, int frame, int frames)
+{
+    float t = frames > 1 ? (float)frame / (frames - 1) : 0.0f;
+    float angle = path.angle_from + (path.angle_to - path.angle_from) * t;
+    setPosition(path.from + (path.to - path.from) * t);
+    setDirection(sf::Vector2f(cos(angle), sin(angle)));
+}
+
+// vertices a frame of the backend is made of, 0 for backends that don't draw with vertices
+static size_t countVertices(RenderBackend &)
+{
+    return 0;
+}
+
+static size_t countVertices(SfmlBackend &backend)
+{
+    const FrameVertices &frame = backend.getFrame();
+    size_t vertices = frame.walls.size() + frame.rows.size() + frame.rays.size();
+    for (const std::vector<sf::Vertex> &slice : frame.sprites)
+    {
+        vertices += slice.size();
+    }
+    return vertices;
+}
+
+template <typename Backend>
+static void runPath(const char *scene, const char *backend_name, Backend &backend, const CameraPath &path, int frames)
+{
+    // one frame to warm up the caches and the thread pool
+    setCamera(path, 0, frames);
+    render(backend);
+
+    double seconds = 0.0;
+    long steps = 0;
+    long sprites = 0;
+    long reused = 0;
+    size_t vertices = 0;
+    for (int i = 0; i < frames; ++i)
+    {
+        setCamera(path, i, frames);
+        auto start = std::chrono::steady_clock::now();
+        render(backend);
+        seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        RenderStats stats = getRenderStats();
+        steps += stats.raySteps;
+        sprites += stats.sprites;
+        reused += stats.reusedRays;
+        vertices += countVertices(backend);
+    }
+
+    double rays = (double)getRayCount() * frames;
+    double columns = (double)getScreenWidth() * frames;
+    printf("%s,%s,%s,%s,%d,%d,%.0f,%.2f,%.0f,%.1f,%.1f,%.0f\n", scene, path.name, backend_name,
+           getRaycastSimdName(getRaycastSimd()), getRenderThreads(), frames, rays / seconds, steps / rays,
+           (double)vertices / frames, seconds * 1e9 / columns, (double)sprites / frames,
+           (double)reused / frames);
+    fflush(stdout);
+}
+
+// time wallSpan() alone on spans of a few heights, from the mip chains and from the atlas
+static void measureWallSampling(Framebuffer &framebuffer, int frames)
+{
+    const int screenWidth = getScreenWidth();
+    const int screenHeight = getScreenHeight();
+    const int heights[] = {screenHeight, 256, 64, 16};
+    for (int height : heights)
+    {
+        double ns[2];
+        for (int mipmaps = 1; mipmaps >= 0; --mipmaps)
+        {
+            framebuffer.setWallMipmaps(mipmaps);
+            auto start = std::chrono::steady_clock::now();
+            for (int frame = 0; frame < frames; ++frame)
+            {
+                for (int x = 0; x < screenWidth; ++x)
+                {
+                    // every column of a tile in turn, as along a wall
+                    sf::Vector2i texture_coords(x % texture_size, x / texture_size % 2 * texture_wall_size);
+                    framebuffer.wallSpan(x, (screenHeight - height) / 2, (screenHeight + height) / 2, texture_coords, sf::Color::White);
+                }
+            }
+            ns[mipmaps] = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() /
+                          ((double)frames * screenWidth);
+        }
+        fprintf(stderr, "wall spans of %d px: %.0f ns from the mip chains, %.0f ns from the atlas\n", height, ns[1], ns[0]);
+    }
+    framebuffer.setWallMipmaps(true);
+}
+
+// time frames of a camera standing in the hall of worldMap, so no rays are cast and the frame time is the
+// time of the kernels, with the kernels of every feature set and with the generic ones. Both take turns in
+// rounds of the frames, the fastest round of each counts, so a slow stretch of the machine doesn't land on
+// one of them only.
+template <typename Backend>
+static void measureKernels(const char *backend_name, Backend &backend, int frames)
+{
+    const int rounds = 6;
+    const int round_frames = std::max(frames / rounds, 1);
+    const bool reuse = getRayReuse();
+    setRayReuse(true);
+    setCamera(scenes[0].paths[1], 0, 1);
+    for (unsigned features = 0; features < render_feature_sets; ++features)
+    {
+        setRenderFeatures(features);
+        double us[2] = {DBL_MAX, DBL_MAX};
+        for (int round = 0; round < rounds; ++round)
+        {
+            for (int specialized = 1; specialized >= 0; --specialized)
+            {
+                setKernelSpecialization(specialized);
+                render(backend);
+                auto start = std::chrono::steady_clock::now();
+                for (int frame = 0; frame < round_frames; ++frame)
+                {
+                    render(backend);
+                }
+                double round_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+                us[specialized] = std::min(us[specialized], round_us / round_frames);
+            }
+        }
+        std::string name;
+        const char *names[] = {"shading", "fog", "lighting"};
+        for (int bit = 0; bit < 3; ++bit)
+        {
+            if (features & (1 << bit))
+            {
+                name += name.empty() ? names[bit] : std::string("+") + names[bit];
+            }
+        }
+        fprintf(stderr, "%s kernels, %s: %.0f us per frame specialized, %.0f us generic (%+.0f%%)\n", backend_name,
+                name.empty() ? "no features" : name.c_str(), us[1], us[0], 100.0 * us[0] / us[1] - 100.0);
+    }
+    setKernelSpecialization(true);
+    setRenderFeatures(render_all_features);
+    setRayReuse(reuse);
+}
+
+// time setting single tiles of a generated map with the occupancy and light updated around them, against
+// building both for the whole map, as every change did before tiles could be set
+static void measureTileEdits(int frames)
+{
+    scenes[1].load();
+    buildOccupancy();
+    bakeLightmap();
+    const int size = generated_size;
+    // a tile of a pillar every time, taken out and put back
+    const int pillars = size / 16 - 1;
+    const int edits = frames * 16;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < edits; ++i)
+    {
+        int x = (i * 7 % pillars) * 16 + 7;
+        int y = (i * 13 % pillars) * 16 + 7;
+        char tile = getTile(x, y);
+        setTile(x, y, '.');
+        setTile(x, y, tile);
+    }
+    double edit_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / (edits * 2);
+
+    start = std::chrono::steady_clock::now();
+    buildOccupancy();
+    bakeLightmap();
+    double rebuild_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    fprintf(stderr, "tile set on a %dx%d map: %.1f us with the occupancy and light around it, %.1f ms to build both for all of it\n",
+            size, size, edit_us, rebuild_ms);
+}
+
+// time batches of small views for many cameras standing on floor tiles of the tiled map all over it, without
+// and with images
+static void measureViews(Framebuffer &framebuffer, int frames)
+{
+    const int cameras = 4096;
+    const int width = 64;
+    const int height = 48;
+    scenes[2].load();
+    buildOccupancy();
+    bakeLightmap();
+    std::vector<ViewCamera> batch(cameras);
+    unsigned random = 1;
+    for (ViewCamera &camera : batch)
+    {
+        random = random * 1103515245 + 12345;
+        sf::Vector2i tile = findFloor(sf::Vector2i(random % generated_size, (random >> 12) % generated_size));
+        float angle = (random >> 20) * (2 * pi / 4096);
+        camera.position = sf::Vector2f(tile) + sf::Vector2f(0.5f, 0.5f);
+        camera.direction = sf::Vector2f(cos(angle), sin(angle));
+        camera.plane = sf::Vector2f(-camera.direction.y, camera.direction.x) * cameraPlane;
+    }
+
+    const unsigned outputs[] = {view_depth | view_tiles | view_texture_columns, view_images};
+    double per_second[2];
+    for (int i = 0; i < 2; ++i)
+    {
+        ViewRenderer views(width, height, outputs[i]);
+        views.setWallTextures(&framebuffer.getWallTextures());
+        views.render(batch.data(), cameras);
+        auto start = std::chrono::steady_clock::now();
+        int batches = std::max(frames / 10, 1);
+        for (int n = 0; n < batches; ++n)
+        {
+            views.render(batch.data(), cameras);
+        }
+        per_second[i] = (double)cameras * batches / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    fprintf(stderr, "%d views of %dx%d at a time: %.0f per second with depth, tiles and texture columns, %.0f per second as images\n",
+            cameras, width, height, per_second[0], per_second[1]);
+}
+
+// time building the sets of sight on the tiled map, and batches of queries from floor tiles in them to tiles
+// up to sight_radius away, looked up in the sets and cast
+static void measureSight(int frames)
+{
+    const int queries = 65536;
+    const int radius = 8; // chunks around the middle of the map with sets
+    scenes[2].load();
+    buildOccupancy();
+    const sf::Vector2i middle(generated_size / 2, generated_size / 2);
+    const int reach = radius * chunk_size;
+    std::vector<SightQuery> batch(queries);
+    std::vector<uint8_t> visible(queries);
+    unsigned random = 1;
+    for (SightQuery &query : batch)
+    {
+        random = random * 1103515245 + 12345;
+        query.from = findFloor(middle + sf::Vector2i(random % (2 * reach) - reach, (random >> 10) % (2 * reach) - reach));
+        query.to = query.from + sf::Vector2i((random >> 20) % sight_size - sight_radius, (random >> 25) % sight_size - sight_radius);
+    }
+
+    clearSight();
+    auto start = std::chrono::steady_clock::now();
+    buildSight(middle, radius);
+    double build_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    const int chunks = getSightChunks();
+    const size_t bytes = getSightBytes();
+
+    // the first batch with the sets, the second with none
+    const int looked = querySight(batch.data(), queries, visible.data());
+    double per_second[2];
+    for (int i = 0; i < 2; ++i)
+    {
+        if (i == 1)
+        {
+            clearSight();
+        }
+        auto start = std::chrono::steady_clock::now();
+        int batches = std::max(frames / 10, 1);
+        for (int n = 0; n < batches; ++n)
+        {
+            querySight(batch.data(), queries, visible.data());
+        }
+        per_second[i] = (double)queries * batches / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    fprintf(stderr, "sight sets of %d chunks built in %.1f ms, %zu bytes per chunk; %d queries at a time: %.0f per second with %d "
+                    "from the sets, %.0f per second all cast\n",
+            chunks, build_ms, chunks > 0 ? bytes / chunks : 0, queries, per_second[0], looked, per_second[1]);
+}
+
+int main(int argc, char **argv)
+{
+    int frames = 120;
+    int threads = 0;
+    const char *only = NULL; // scene to run, all of them if NULL
+    int width = default_screen_width;
+    int height = default_screen_height;
+    int rays = 0; // per frame, 0 for one per screen column
+    // every ray is cast unless asked for, so rays per second measure casting
+    setRayReuse(false);
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+            frames = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--scalar") == 0)
+            setRaycastSimd(RaycastSimd::Scalar);
+        else if (strcmp(argv[i], "--no-skip") == 0)
+            setEmptySpaceSkipping(false);
+        else if (strcmp(argv[i], "--resolution") == 0 && i + 1 < argc && sscanf(argv[i + 1], "%dx%d", &width, &height) == 2)
+            ++i;
+        else if (strcmp(argv[i], "--rays") == 0 && i + 1 < argc)
+            rays = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--reuse") == 0)
+            setRayReuse(true);
+        else if (strcmp(argv[i], "--scene") == 0 && i + 1 < argc)
+            only = argv[++i];
+        else
+        {
+            fprintf(stderr, "usage: %s [--frames N] [--threads N] [--scalar] [--no-skip] [--reuse] [--resolution WxH] [--rays N] [--scene name]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (frames < 1)
+    {
+        fprintf(stderr, "--frames must be at least 1\n");
+        return EXIT_FAILURE;
+    }
+    setRenderThreads(threads);
+
+    setResolution(width, height);
+    if (rays > 0)
+    {
+        setRayCount(rays);
+    }
+    Framebuffer framebuffer(getScreenWidth(), getScreenHeight());
+    if (!framebuffer.loadTexture("data/texture/walls.png") || !framebuffer.loadSpriteTexture("data/texture/bush.png"))
+    {
+        fprintf(stderr, "Cannot open texture!\n");
+        return EXIT_FAILURE;
+    }
+    SfmlBackend sfml;
+    // on stderr, so stdout stays CSV
+    size_t atlas_bytes = (size_t)texture_size * texture_size * 4;
+    fprintf(stderr, "wall textures: %zu KB atlas, %zu KB column mip chains (%+.0f%%)\n", atlas_bytes / 1024,
+            framebuffer.getWallTextures().getBytes() / 1024,
+            100.0 * framebuffer.getWallTextures().getBytes() / atlas_bytes - 100.0);
+    measureWallSampling(framebuffer, frames);
+    scenes[0].load();
+    buildOccupancy();
+    bakeLightmap();
+    measureKernels("sfml", sfml, frames);
+    measureKernels("framebuffer", framebuffer, frames);
+    measureTileEdits(frames);
+    measureViews(framebuffer, frames);
+    measureSight(frames);
+
+    printf("scene,path,backend,simd,threads,frames,rays_per_s,steps_per_ray,vertices_per_frame,ns_per_column,sprites_per_frame,reused_per_frame\n");
+    for (const Scene &scene : scenes)
+    {
+        if (only && strcmp(only, scene.name) != 0)
+        {
+            continue;
+        }
+        scene.load();
+        if (!checkMap())
+        {
+            fprintf(stderr, "Map %s is invalid!\n", scene.name);
+            return EXIT_FAILURE;
+        }
+        buildOccupancy();
+        bakeLightmap();
+        clearEntities();
+        scatterEntities(scene.entities, 1);
+
+        for (const CameraPath &path : scene.paths)
+        {
+            runPath(scene.name, "sfml", sfml, path, frames);
+            runPath(scene.name, "framebuffer", framebuffer, path, frames);
+            // walls sampled from the row major atlas, as before the mip chains
+            framebuffer.setWallMipmaps(false);
+            runPath(scene.name, "framebuffer_atlas", framebuffer, path, frames);
+            framebuffer.setWallMipmaps(true);
+        }
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,32 @@
+#include "Allocations.h"
+#include <stdlib.h>
+#include <atomic>
+#include <new>
+
+static std::atomic<size_t> allocations{0};
+
+size_t getHeapAllocations()
+{
+    return allocations;
+}
+
+// counting replacements of the global allocation functions, the default array and nothrow forms call them
+void *operator new(size_t size)
+{
+    ++allocations;
+    if (void *memory = malloc(size ? size : 1))
+    {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *memory) noexcept
+{
+    free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept
+{
+    free(memory);
+}
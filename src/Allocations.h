@@ -0,0 +1,9 @@
+#ifndef Allocations_hpp
+#define Allocations_hpp
+#include <stddef.h>
+
+// number of heap allocations made with operator new since the start of the program, by any thread.
+// Frames in a steady state are expected to make none.
+size_t getHeapAllocations();
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef Backend_hpp
+#define Backend_hpp
+#include <SFML/Graphics.hpp>
+
+// backends render() has kernels of its own for, their spans are drawn without virtual calls
+enum BackendKind
+{
+    OtherBackend,
+    FramebufferBackend,
+    WindowBackend,
+    BackendKinds
+};
+
+// output side of the raycaster. render() hands every span of the frame to a backend, which turns it
+// into something that can be shown: SFML line lists for the window or pixels in a software framebuffer
+class RenderBackend
+{
+public:
+    explicit RenderBackend(BackendKind kind = OtherBackend) : kind(kind) {}
+    virtual ~RenderBackend() {}
+
+    // which kernels render() draws into the backend with, fixed when it's made
+    BackendKind getKind() const
+    {
+        return kind;
+    }
+
+    // called by render() before the first span of a frame of width x height pixels. The backend resizes
+    // its buffers when that isn't the size of the frame before.
+    // Floor and ceiling rows come first, all of them are done before the first wall span. Rows can come
+    // from different threads at the same time.
+    // Walls are rendered in parallel slices of rays, wall spans of different slices can come from
+    // different threads at the same time, spans within one slice come from one thread in column order.
+    // Sprite spans come after all wall spans, in slices of slice_width columns, back to front within each
+    // slice.
+    virtual void beginFrame(int width, int height, int slice_width) = 0;
+    // screen row y of the ceiling (above the horizon) or the floor, textured with its tile texture repeated
+    // over the map. from and to are the map positions seen at the left and right edge of the screen.
+    virtual void floorRow(int y, sf::Vector2f from, sf::Vector2f to, sf::Color color) = 0;
+    // textured wall in screen column x between draw_start and draw_end. Neighbour columns of a ray drawn
+    // over more than one get the same span.
+    // texture_coords is the top of the wall column in the full texture
+    virtual void wallSpan(int x, int draw_start, int draw_end, sf::Vector2i texture_coords, sf::Color color) = 0;
+    // column of a sprite in screen column x between draw_start and draw_end, over the walls,
+    // texture_coords is the top of the sprite column in the sprite texture. Transparent texels are left out.
+    virtual void spriteSpan(int x, int draw_start, int draw_end, sf::Vector2i texture_coords, sf::Color color) = 0;
+    // ray of screen column x on the minimap, both ends in map coordinates
+    virtual void mapRay(int x, sf::Vector2f from, sf::Vector2f to) = 0;
+    // called by render() after the last span of a frame
+    virtual void endFrame() {}
+
+private:
+    BackendKind kind;
+};
+
+#endif
@@ -0,0 +1,173 @@
+#ifndef Dda_hpp
+#define Dda_hpp
+#include <math.h>
+#include <SFML/Graphics.hpp>
+#include "Occupancy.h"
+
+// Grid traversal of a single ray, shared by the rays of the renderer and by sight lines over the map.
+// The packet versions of castRays() do the same float operations lane by lane.
+
+// A single ray in the DDA. Distances to the next grid lines are computed from the number of steps taken
+// on each axis, (steps + offset) * delta, instead of being summed up step by step. So skipping many
+// tiles at once ends in exactly the state stepping through them would.
+struct DdaRay
+{
+    sf::Vector2f pos;
+    sf::Vector2f dir;
+    // distance traversed between each grid line for x and y
+    sf::Vector2f delta;
+    // distance from the start to the first grid line, in units of delta
+    sf::Vector2f offset;
+    // what direction to step in (+1 or -1 for each dimension)
+    sf::Vector2i step;
+    // which box of the map we're in
+    sf::Vector2i mapPos;
+    // number of steps taken on each axis
+    sf::Vector2i taken;
+    // did the last step cross a horizontal side? Otherwise it's vertical
+    bool horizontal;
+    // wall distance after the last step, projected on camera direction
+    float distance;
+};
+
+inline void initRay(DdaRay &ray, sf::Vector2f rayPos, sf::Vector2f rayDir)
+{
+    ray.pos = rayPos;
+    ray.dir = rayDir;
+
+    // NOTE: with floats, division by zero gives you the "infinity" value. This code depends on this.
+
+    // calculate distance traversed between each grid line for x and y based on direction
+    ray.delta = sf::Vector2f(
+        sqrt(1.0f + (rayDir.y * rayDir.y) / (rayDir.x * rayDir.x)),
+        sqrt(1.0f + (rayDir.x * rayDir.x) / (rayDir.y * rayDir.y)));
+
+    ray.mapPos = sf::Vector2i(rayPos);
+
+    // calculate step and distance to the first grid line
+    if (rayDir.x < 0.0f)
+    {
+        ray.step.x = -1;
+        ray.offset.x = rayPos.x - ray.mapPos.x;
+    }
+    else
+    {
+        ray.step.x = 1;
+        ray.offset.x = ray.mapPos.x + 1.0f - rayPos.x;
+    }
+    if (rayDir.y < 0.0f)
+    {
+        ray.step.y = -1;
+        ray.offset.y = rayPos.y - ray.mapPos.y;
+    }
+    else
+    {
+        ray.step.y = 1;
+        ray.offset.y = ray.mapPos.y + 1.0f - rayPos.y;
+    }
+
+    ray.taken = sf::Vector2i(0, 0);
+    ray.horizontal = false;
+    ray.distance = 0.0f;
+}
+
+// distance along the ray to the grid line crossed by step n on each axis, counted from 0
+inline float sideX(const DdaRay &ray, int n)
+{
+    return (n + ray.offset.x) * ray.delta.x;
+}
+
+inline float sideY(const DdaRay &ray, int n)
+{
+    return (n + ray.offset.y) * ray.delta.y;
+}
+
+inline float distanceX(const DdaRay &ray)
+{
+    return (ray.mapPos.x - ray.pos.x + (1 - ray.step.x) / 2) / ray.dir.x;
+}
+
+inline float distanceY(const DdaRay &ray)
+{
+    return (ray.mapPos.y - ray.pos.y + (1 - ray.step.y) / 2) / ray.dir.y;
+}
+
+// cross the next grid line
+inline void stepRay(DdaRay &ray)
+{
+    if (sideX(ray, ray.taken.x) < sideY(ray, ray.taken.y))
+    {
+        ++ray.taken.x;
+        ray.mapPos.x += ray.step.x;
+        ray.horizontal = true;
+        ray.distance = distanceX(ray);
+    }
+    else
+    {
+        ++ray.taken.y;
+        ray.mapPos.y += ray.step.y;
+        ray.horizontal = false;
+        ray.distance = distanceY(ray);
+    }
+}
+
+// largest n in [0, limit] for which passes(n) holds, passes(0) is assumed and passes is monotone
+template <typename Passes>
+inline int countSteps(int limit, Passes passes)
+{
+    int low = 0;
+    while (low < limit)
+    {
+        int middle = (low + limit + 1) / 2;
+        if (passes(middle))
+            low = middle;
+        else
+            limit = middle - 1;
+    }
+    return low;
+}
+
+// move the ray from inside an empty block to the first tile outside of it, taking all the steps
+// stepRay() would take at once. stepRay() crosses the x line when sideX < sideY and both sequences grow,
+// so the line the ray leaves through and the number of steps on the other axis before it follow from
+// comparing side distances.
+// returns: number of grid lines crossed
+inline int skipBlock(DdaRay &ray, int block_x, int block_y, int size)
+{
+    // steps on each axis until the ray is out of the block
+    int exit_x = ray.step.x > 0 ? block_x + size - ray.mapPos.x : ray.mapPos.x - block_x + 1;
+    int exit_y = ray.step.y > 0 ? block_y + size - ray.mapPos.y : ray.mapPos.y - block_y + 1;
+    float side_x = sideX(ray, ray.taken.x + exit_x - 1);
+    float side_y = sideY(ray, ray.taken.y + exit_y - 1);
+
+    sf::Vector2i steps;
+    if (side_x < side_y)
+    {
+        // leaves through a vertical grid line, every y step before it is one that doesn't lose against it
+        steps.x = exit_x;
+        steps.y = countSteps(exit_y - 1, [&ray, side_x](int n) { return !(side_x < sideY(ray, ray.taken.y + n - 1)); });
+    }
+    else
+    {
+        steps.y = exit_y;
+        steps.x = countSteps(exit_x - 1, [&ray, side_y](int n) { return sideX(ray, ray.taken.x + n - 1) < side_y; });
+    }
+
+    ray.taken += steps;
+    ray.mapPos.x += ray.step.x * steps.x;
+    ray.mapPos.y += ray.step.y * steps.y;
+    ray.horizontal = side_x < side_y;
+    ray.distance = ray.horizontal ? distanceX(ray) : distanceY(ray);
+    return steps.x + steps.y;
+}
+
+// skip the empty block around the tile of the ray if there is one
+// returns: number of grid lines crossed, 0 if there is no empty block
+inline int trySkip(DdaRay &ray)
+{
+    int block_x, block_y;
+    int size = getEmptyBlock(ray.mapPos.x, ray.mapPos.y, block_x, block_y);
+    return size ? skipBlock(ray, block_x, block_y, size) : 0;
+}
+
+#endif
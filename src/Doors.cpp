@@ -0,0 +1,179 @@
+#include "Doors.h"
+#include <math.h>
+#include <algorithm>
+#include <vector>
+#include "Entities.h"
+#include "Navigation.h"
+#include "Player.h"
+
+struct Door
+{
+    sf::Vector2i tile;
+    float opening; // 0 closed, 1 open
+    float idle;    // seconds it's been open without the player in reach
+    int next;      // next door of the same map chunk in doors, -1 for the last one
+};
+
+static std::vector<Door> doors;
+// first door of every map chunk in doors, -1 for chunks without one, so the renderer finds the door of a
+// tile it hit without going through all of them
+static std::vector<int> chunkDoors;
+static int chunksX = 0;
+
+static int &getChunkDoor(sf::Vector2i tile)
+{
+    return chunkDoors[(size_t)(tile.y >> chunk_shift) * chunksX + (tile.x >> chunk_shift)];
+}
+
+// index of the door of tile in doors, -1 if it isn't tracked
+static int findDoor(sf::Vector2i tile)
+{
+    int i = getChunkDoor(tile);
+    while (i >= 0 && doors[i].tile != tile)
+    {
+        i = doors[i].next;
+    }
+    return i;
+}
+
+static bool isInReach(sf::Vector2i tile, sf::Vector2f position)
+{
+    sf::Vector2f offset = position - sf::Vector2f(tile.x + 0.5f, tile.y + 0.5f);
+    return offset.x * offset.x + offset.y * offset.y <= door_reach * door_reach;
+}
+
+// does a box of size with its middle at position overlap the tile?
+static bool isOnTile(sf::Vector2i tile, sf::Vector2f position, float size)
+{
+    float reach = 0.5f + size / 2;
+    return fabsf(position.x - (tile.x + 0.5f)) < reach && fabsf(position.y - (tile.y + 0.5f)) < reach;
+}
+
+// can the door of tile close, with neither the player nor an entity in it?
+static bool isDoorFree(sf::Vector2i tile)
+{
+    if (isOnTile(tile, getPosition(), collision_box))
+    {
+        return false;
+    }
+    // entities stand with their middle in the cell they are sorted into, look in the cells they can reach
+    // the tile from
+    const float margin = agent_size / 2;
+    int cell_x0 = std::max((int)(tile.x - margin) >> entity_cell_shift, 0);
+    int cell_y0 = std::max((int)(tile.y - margin) >> entity_cell_shift, 0);
+    int cell_x1 = std::min((int)(tile.x + 1 + margin) >> entity_cell_shift, getEntityCellsX() - 1);
+    int cell_y1 = std::min((int)(tile.y + 1 + margin) >> entity_cell_shift, getEntityCellsY() - 1);
+    for (int cell_y = cell_y0; cell_y <= cell_y1; ++cell_y)
+    {
+        for (int cell_x = cell_x0; cell_x <= cell_x1; ++cell_x)
+        {
+            for (int id = getCellEntity(cell_x, cell_y); id >= 0; id = getNextEntity(id))
+            {
+                if (isOnTile(tile, getEntity(id).position, agent_size))
+                {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+void clearDoors()
+{
+    doors.clear();
+    // room for the doors around the player, so ticks don't allocate
+    doors.reserve(16);
+    chunksX = getMapChunksX();
+    int chunksY = (getMapHeight() + chunk_mask) / chunk_size;
+    chunkDoors.assign((size_t)chunksX * chunksY, -1);
+}
+
+void updateDoors(float dt)
+{
+    // doors in reach start to open, except on the edge of the map, which has to stay closed
+    sf::Vector2f player = getPosition();
+    int x0 = std::max((int)floorf(player.x - door_reach), 1);
+    int y0 = std::max((int)floorf(player.y - door_reach), 1);
+    int x1 = std::min((int)floorf(player.x + door_reach), getMapWidth() - 2);
+    int y1 = std::min((int)floorf(player.y + door_reach), getMapHeight() - 2);
+    for (int y = y0; y <= y1; ++y)
+    {
+        for (int x = x0; x <= x1; ++x)
+        {
+            char tile = getTile(x, y);
+            if ((getTileAttributes(tile) & tile_door) && isInReach(sf::Vector2i(x, y), player) &&
+                findDoor(sf::Vector2i(x, y)) < 0)
+            {
+                int &first = getChunkDoor(sf::Vector2i(x, y));
+                doors.push_back(Door{sf::Vector2i(x, y), tile == door_open_tile ? 1.0f : 0.0f, 0.0f, first});
+                first = doors.size() - 1;
+            }
+        }
+    }
+
+    // doors that close move others in their place, the chunks are pointed to them again afterwards
+    for (const Door &door : doors)
+    {
+        getChunkDoor(door.tile) = -1;
+    }
+    // all tiles of the tick are published together
+    beginTileEdits();
+    for (size_t i = 0; i < doors.size();)
+    {
+        Door &door = doors[i];
+        char tile = getTile(door.tile.x, door.tile.y);
+        // the tile was set to something else, or a streamed chunk went away
+        bool gone = !(getTileAttributes(tile) & tile_door);
+        if (!gone && isInReach(door.tile, player))
+        {
+            door.idle = 0.0f;
+            door.opening = std::min(door.opening + dt / door_time, 1.0f);
+            if (door.opening >= 1.0f && tile != door_open_tile)
+            {
+                setTile(door.tile.x, door.tile.y, door_open_tile);
+            }
+        }
+        else if (!gone && door.opening >= 1.0f && door.idle < door_hold)
+        {
+            door.idle += dt;
+        }
+        else if (!gone && (tile == door_closed_tile || isDoorFree(door.tile)))
+        {
+            setTile(door.tile.x, door.tile.y, door_closed_tile);
+            door.opening = std::max(door.opening - dt / door_time, 0.0f);
+            gone = door.opening <= 0.0f;
+        }
+        if (gone)
+        {
+            doors[i] = doors.back();
+            doors.pop_back();
+        }
+        else
+        {
+            ++i;
+        }
+    }
+    endTileEdits();
+    for (int i = 0; i < (int)doors.size(); ++i)
+    {
+        int &first = getChunkDoor(doors[i].tile);
+        doors[i].next = first;
+        first = i;
+    }
+}
+
+float getDoorOpening(int x, int y)
+{
+    if (doors.empty() || x < 0 || y < 0 || x >= getMapWidth() || y >= getMapHeight())
+    {
+        return 0.0f;
+    }
+    int i = findDoor(sf::Vector2i(x, y));
+    return i >= 0 ? doors[i].opening : 0.0f;
+}
+
+int getOpenDoorCount()
+{
+    return doors.size();
+}
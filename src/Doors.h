@@ -0,0 +1,30 @@
+#ifndef Doors_hpp
+#define Doors_hpp
+#include <SFML/Graphics.hpp>
+#include "Map.h"
+
+// Door tiles open when the player comes close and close again a while after the player left, unless
+// something stands in them. While a door opens or closes it stays solid and the renderer slides its
+// texture aside by how far it's open. Once it's completely open the tile is set to door_open_tile, which
+// is walked through like floor, and set back to door_closed_tile as soon as it starts closing. Only the
+// doors that aren't closed are kept track of.
+
+const char door_closed_tile = '3';
+const char door_open_tile = '_';
+// distance from the middle of a door tile at which the player opens it
+const float door_reach = 1.5f;
+// seconds a door takes to open or close
+const float door_time = 0.5f;
+// seconds a door stays open after the player left its reach
+const float door_hold = 2.0f;
+
+// forget all doors, for a newly loaded map
+void clearDoors();
+// move the doors dt seconds on, open the ones in reach of the player
+void updateDoors(float dt);
+// how far the door of tile x, y is open, 0 closed and 1 open
+float getDoorOpening(int x, int y);
+// doors that aren't closed
+int getOpenDoorCount();
+
+#endif
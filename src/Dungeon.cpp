@@ -0,0 +1,257 @@
+#include "Dungeon.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+#include "Map.h"
+
+// sides of a chunk
+enum Side
+{
+    West,
+    East,
+    North,
+    South
+};
+
+// rooms in a chunk, and tries to place them
+const int dungeon_rooms = 4;
+const int dungeon_room_tries = 12;
+// smallest and largest room side, inside of its walls
+const int room_min = 4;
+const int room_max = 10;
+
+// free inside of a room
+struct Room
+{
+    int x;
+    int y;
+    int w;
+    int h;
+};
+
+// mixes the seed and the coordinates, so neighbour chunks get unrelated numbers
+static uint32_t hash(unsigned seed, int x, int y, uint32_t salt)
+{
+    uint32_t h = seed ^ (salt * 0x9e3779b9u);
+    h ^= (uint32_t)x * 0x85ebca6bu;
+    h = (h ^ (h >> 16)) * 0x7feb352du;
+    h ^= (uint32_t)y * 0xc2b2ae35u;
+    h = (h ^ (h >> 15)) * 0x846ca68bu;
+    return h ^ (h >> 16);
+}
+
+// tile of the opening along the side of chunk x, y, -1 for the sides of the world.
+// The two chunks at a border ask for the same one.
+static int getOpening(unsigned seed, int x, int y, Side side)
+{
+    // openings stay off the corners, where rooms can't reach them
+    const int range = dungeon_chunk_size - 6;
+    switch (side)
+    {
+    case West:
+        return x == 0 ? -1 : 3 + hash(seed, x, y, 1) % range;
+    case East:
+        return x + 1 == dungeon_chunks ? -1 : 3 + hash(seed, x + 1, y, 1) % range;
+    case North:
+        return y == 0 ? -1 : 3 + hash(seed, x, y, 2) % range;
+    default:
+        return y + 1 == dungeon_chunks ? -1 : 3 + hash(seed, x, y + 1, 2) % range;
+    }
+}
+
+// tile on the side of a chunk at offset along it
+static sf::Vector2i getSideTile(Side side, int offset)
+{
+    switch (side)
+    {
+    case West:
+        return sf::Vector2i(0, offset);
+    case East:
+        return sf::Vector2i(dungeon_chunk_size - 1, offset);
+    case North:
+        return sf::Vector2i(offset, 0);
+    default:
+        return sf::Vector2i(offset, dungeon_chunk_size - 1);
+    }
+}
+
+// floor on the tiles from a to b, a straight line
+static void carveLine(char *tiles, sf::Vector2i a, sf::Vector2i b)
+{
+    for (int y = std::min(a.y, b.y); y <= std::max(a.y, b.y); ++y)
+    {
+        for (int x = std::min(a.x, b.x); x <= std::max(a.x, b.x); ++x)
+        {
+            tiles[y * dungeon_chunk_size + x] = '.';
+        }
+    }
+}
+
+// floor along x first and then along y from a to b, or the other way around
+static void carveCorridor(char *tiles, sf::Vector2i a, sf::Vector2i b, bool x_first)
+{
+    sf::Vector2i corner = x_first ? sf::Vector2i(b.x, a.y) : sf::Vector2i(a.x, b.y);
+    carveLine(tiles, a, corner);
+    carveLine(tiles, corner, b);
+}
+
+void generateDungeonChunk(unsigned seed, int chunk_x, int chunk_y, char *tiles)
+{
+    // linear congruential generator, the same sequence for the same chunk
+    uint32_t state = hash(seed, chunk_x, chunk_y, 0);
+    auto random = [&state](int range) {
+        state = state * 1103515245u + 12345u;
+        return (int)((state >> 8) % (unsigned)range);
+    };
+
+    std::fill(tiles, tiles + dungeon_chunk_size * dungeon_chunk_size, '1');
+
+    // rooms with their walls inside of the walls of the chunk, and a wall between each other
+    Room rooms[dungeon_rooms];
+    int room_count = 0;
+    for (int i = 0; i < dungeon_room_tries && room_count < dungeon_rooms; ++i)
+    {
+        Room room;
+        room.w = room_min + random(room_max - room_min + 1);
+        room.h = room_min + random(room_max - room_min + 1);
+        room.x = 2 + random(dungeon_chunk_size - 3 - room.w);
+        room.y = 2 + random(dungeon_chunk_size - 3 - room.h);
+        bool overlaps = false;
+        for (int j = 0; j < room_count; ++j)
+        {
+            const Room &other = rooms[j];
+            overlaps |= room.x < other.x + other.w + 2 && other.x < room.x + room.w + 2 &&
+                        room.y < other.y + other.h + 2 && other.y < room.y + room.h + 2;
+        }
+        if (!overlaps)
+        {
+            rooms[room_count++] = room;
+        }
+    }
+    for (int i = 0; i < room_count; ++i)
+    {
+        for (int y = rooms[i].y; y < rooms[i].y + rooms[i].h; ++y)
+        {
+            std::fill(tiles + y * dungeon_chunk_size + rooms[i].x, tiles + y * dungeon_chunk_size + rooms[i].x + rooms[i].w, '.');
+        }
+    }
+
+    // everything leads to the first room
+    sf::Vector2i hub(rooms[0].x + rooms[0].w / 2, rooms[0].y + rooms[0].h / 2);
+    for (int i = 1; i < room_count; ++i)
+    {
+        carveCorridor(tiles, sf::Vector2i(rooms[i].x + rooms[i].w / 2, rooms[i].y + rooms[i].h / 2), hub, random(2));
+    }
+    for (int side = West; side <= South; ++side)
+    {
+        int opening = getOpening(seed, chunk_x, chunk_y, (Side)side);
+        if (opening < 0)
+        {
+            continue;
+        }
+        sf::Vector2i tile = getSideTile((Side)side, opening);
+        tiles[tile.y * dungeon_chunk_size + tile.x] = '.';
+        // the corridor starts one tile in, along the walls of the chunk at most
+        sf::Vector2i inside(std::min(std::max(tile.x, 1), dungeon_chunk_size - 2), std::min(std::max(tile.y, 1), dungeon_chunk_size - 2));
+        carveCorridor(tiles, inside, hub, side == West || side == East);
+    }
+
+    // lamps and doors in the walls of the rooms, where the corridors left them
+    for (int i = 0; i < room_count; ++i)
+    {
+        const Room &room = rooms[i];
+        int lamps = 1 + random(2);
+        for (int n = 0; n <= lamps; ++n)
+        {
+            // a tile along one of the sides, without the corners
+            int side = random(4);
+            int along = random(side < 2 ? room.h : room.w);
+            sf::Vector2i tile = side == West    ? sf::Vector2i(room.x - 1, room.y + along)
+                                : side == East  ? sf::Vector2i(room.x + room.w, room.y + along)
+                                : side == North ? sf::Vector2i(room.x + along, room.y - 1)
+                                                : sf::Vector2i(room.x + along, room.y + room.h);
+            char &wall = tiles[tile.y * dungeon_chunk_size + tile.x];
+            if (wall == '1')
+            {
+                // the last one is the door
+                wall = n < lamps ? '5' : '3';
+            }
+        }
+    }
+}
+
+bool checkDungeonChunk(unsigned seed, int chunk_x, int chunk_y, const char *tiles)
+{
+    const int size = dungeon_chunk_size;
+    int floors = 0;
+    int first = -1;
+    for (int y = 0; y < size; ++y)
+    {
+        for (int x = 0; x < size; ++x)
+        {
+            char tile = tiles[y * size + x];
+            if (!(getTileAttributes(tile) & tile_valid))
+            {
+                fprintf(stderr, "chunk [%d,%d] tile at [%2d,%2d] has an unknown tile type(%c)\n", chunk_x, chunk_y, x, y, tile);
+                return false;
+            }
+            if (!(getTileAttributes(tile) & tile_solid))
+            {
+                first = first < 0 ? y * size + x : first;
+                ++floors;
+            }
+        }
+    }
+
+    // sides are walls, apart from the openings shared with the neighbours
+    for (int side = West; side <= South; ++side)
+    {
+        int opening = getOpening(seed, chunk_x, chunk_y, (Side)side);
+        for (int offset = 0; offset < size; ++offset)
+        {
+            sf::Vector2i tile = getSideTile((Side)side, offset);
+            bool solid = getTileAttributes(tiles[tile.y * size + tile.x]) & tile_solid;
+            if (solid == (offset == opening))
+            {
+                fprintf(stderr, "chunk [%d,%d] side at [%2d,%2d] is a %s\n", chunk_x, chunk_y, tile.x, tile.y,
+                        solid ? "wall (should be an opening)" : "floor (should be wall)");
+                return false;
+            }
+        }
+    }
+
+    // all floor connected
+    if (first < 0)
+    {
+        fprintf(stderr, "chunk [%d,%d] has no floor\n", chunk_x, chunk_y);
+        return false;
+    }
+    std::vector<bool> reached(size * size, false);
+    std::vector<int> queue(1, first);
+    reached[first] = true;
+    for (size_t head = 0; head < queue.size(); ++head)
+    {
+        int x = queue[head] % size;
+        int y = queue[head] / size;
+        const sf::Vector2i steps[4] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+        for (sf::Vector2i step : steps)
+        {
+            int nx = x + step.x;
+            int ny = y + step.y;
+            int next = ny * size + nx;
+            if (nx >= 0 && ny >= 0 && nx < size && ny < size && !reached[next] &&
+                !(getTileAttributes(tiles[next]) & tile_solid))
+            {
+                reached[next] = true;
+                queue.push_back(next);
+            }
+        }
+    }
+    if ((int)queue.size() != floors)
+    {
+        fprintf(stderr, "chunk [%d,%d] has %d floor tiles that can't be reached\n", chunk_x, chunk_y, floors - (int)queue.size());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,25 @@
+#ifndef Dungeon_hpp
+#define Dungeon_hpp
+#include <SFML/Graphics.hpp>
+
+// Procedural dungeon, made of square chunks of dungeon_chunk_size tiles that are generated independently
+// from the seed and their coordinates. Every chunk is surrounded by walls with one opening in the middle
+// part of each side, at the same place as the opening of the neighbour, so corridors run across the
+// chunk borders. Inside are rooms with lamps ('5') and doors ('3') in their walls, all of them and the
+// openings connected by corridors, so the whole dungeon can be walked through.
+
+const int dungeon_chunk_shift = 5;
+const int dungeon_chunk_size = 1 << dungeon_chunk_shift;
+const int dungeon_chunk_mask = dungeon_chunk_size - 1;
+// chunks along each side of the dungeon, the sides of the world have no openings
+const int dungeon_chunks = 256;
+// size of the dungeon in tiles
+const int dungeon_size = dungeon_chunks * dungeon_chunk_size;
+
+// write the tiles of chunk x, y, row by row, dungeon_chunk_size * dungeon_chunk_size of them
+void generateDungeonChunk(unsigned seed, int x, int y, char *tiles);
+// checkMap() for a generated chunk: valid tiles, walls on the sides apart from the openings, and all
+// floor reachable from each other. Prints the first error found.
+bool checkDungeonChunk(unsigned seed, int x, int y, const char *tiles);
+
+#endif
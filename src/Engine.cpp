@@ -1,226 +1,584 @@
 #include "Engine.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "Doors.h"
+#include "Framebuffer.h"
+#include "Lightmap.h"
+#include "Profiler.h"
+#include "Raycast.h"
+#include "Sprites.h"
+#include "ThreadPool.h"
+#include "Window.h"
 
-// lines used to draw walls on the screen
-sf::VertexArray lines(sf::Lines);
-// lines of minimap
-sf::VertexArray maplines(sf::Lines);
-// lines of cellings and flores
-sf::VertexArray floorlines(sf::Lines);
+// workers casting the rays, every slice of screen columns is a task for them
+static std::unique_ptr<ThreadPool> pool;
+// summed up from the packets of all slices
+static std::atomic<long> frameSteps;
+static std::atomic<long> frameLines;
+// resolution and rays cast per frame
+static int screenWidth = default_screen_width;
+static int screenHeight = default_screen_height;
+static int rayCount = default_screen_width;
+// wall distance of every screen column, sprites behind it are hidden
+static std::vector<float> columnDepth(default_screen_width);
 
-void render()
+// what a ray hit
+struct RayHit
 {
-    // loop through vertical screen lines, draw a line of wall for each
-    for (int x = 0; x < screenWidth; ++x)
+    sf::Vector2f dir;
+    sf::Vector2i mapPos;
+    char tile;
+    bool horizontal;
+    float distance;
+    float wall_x;
+    int tex_x;
+};
+
+// hits of the last frame and the one before, room for one ray per column. Between frames that see the
+// same map from the same place, the hits are taken over instead of casting the rays again: all of them if
+// the camera didn't turn, the ones between two rays of the last frame that hit the same wall face if it did.
+static std::vector<RayHit> rayHits[2] = {std::vector<RayHit>(default_screen_width), std::vector<RayHit>(default_screen_width)};
+static int currentHits = 0;
+// view the hits in rayHits[currentHits] were cast for
+// where the frame render() draws is seen from, for the kernels
+static sf::Vector2f framePosition;
+static bool hitsValid = false;
+static int hitsRays = 0;
+static sf::Vector2f hitsPosition;
+static sf::Vector2f hitsDirection;
+static sf::Vector2f hitsPlane;
+static uint32_t hitsMapVersion = 0;
+static bool reuseHits = true;
+static std::atomic<long> frameReused;
+
+static unsigned renderFeatures = render_all_features;
+static bool specializedKernels = true;
+
+// frame budget of adaptRayCount(), and the time of the frames since the ray count last changed
+static float frameBudget = 0.0f;
+static float adaptTime = 0.0f;
+static int adaptFrames = 0;
+
+void setResolution(int width, int height)
+{
+    screenWidth = std::max(width, min_screen_width);
+    screenHeight = std::max(height, min_screen_height);
+    rayCount = screenWidth;
+    columnDepth.assign(screenWidth, 0.0f);
+    rayHits[0].resize(screenWidth);
+    rayHits[1].resize(screenWidth);
+    hitsValid = false;
+    adaptTime = 0.0f;
+    adaptFrames = 0;
+}
+
+int getScreenWidth()
+{
+    return screenWidth;
+}
+
+int getScreenHeight()
+{
+    return screenHeight;
+}
+
+int getHorizon()
+{
+    return screenHeight / 2;
+}
+
+void setRenderFeatures(unsigned features)
+{
+    renderFeatures = features & render_all_features;
+}
+
+unsigned getRenderFeatures()
+{
+    return renderFeatures;
+}
+
+void setKernelSpecialization(bool specialized)
+{
+    specializedKernels = specialized;
+}
+
+bool getKernelSpecialization()
+{
+    return specializedKernels;
+}
+
+void setRayCount(int rays)
+{
+    rayCount = std::min(std::max(rays, 1), screenWidth);
+}
+
+int getRayCount()
+{
+    return rayCount;
+}
+
+void setFrameBudget(float seconds)
+{
+    frameBudget = seconds;
+    adaptTime = 0.0f;
+    adaptFrames = 0;
+}
+
+float getFrameBudget()
+{
+    return frameBudget;
+}
+
+void adaptRayCount(float frame_seconds)
+{
+    if (frameBudget <= 0.0f)
+    {
+        return;
+    }
+    // every change is measured over a few frames before the next one
+    adaptTime += frame_seconds;
+    if (++adaptFrames < ray_adapt_frames)
+    {
+        return;
+    }
+    float average = adaptTime / adaptFrames;
+    adaptTime = 0.0f;
+    adaptFrames = 0;
+
+    int rays = rayCount;
+    if (average > frameBudget)
     {
+        // rays take most of the frame, fewer of them in proportion, but at most half of them at once
+        rays = (int)(rayCount * std::max(0.5f, frameBudget / average));
+    }
+    else if (average < frameBudget * ray_headroom)
+    {
+        // by a packet at least, below 1 / (ray_raise - 1) packets the raise would be rounded away
+        rays = std::max((int)(rayCount * ray_raise), rayCount + (int)RayPacket::size);
+    }
+    // whole packets, between the fewest rays and one per column
+    rays = rays / RayPacket::size * RayPacket::size;
+    setRayCount(std::max(rays, std::max(screenWidth / ray_min_divisor, (int)RayPacket::size)));
+}
 
-        // ray to emit
-        float cameraX = 2 * x / (float)screenWidth - 1.0f; // x in camera space (between -1 and +1)
-        sf::Vector2f rayPos = getPosition();
-        sf::Vector2f rayDir = getDirection() + getPlane() * cameraX;
+void setRayReuse(bool reuse)
+{
+    reuseHits = reuse;
+    hitsValid = false;
+}
 
-        // NOTE: with floats, division by zero gives you the "infinity" value. This code depends on this.
+bool getRayReuse()
+{
+    return reuseHits;
+}
 
-        // calculate distance traversed between each grid line for x and y based on direction
-        sf::Vector2f deltaDist(
-            sqrt(1.0f + (rayDir.y * rayDir.y) / (rayDir.x * rayDir.x)),
-            sqrt(1.0f + (rayDir.x * rayDir.x) / (rayDir.y * rayDir.y)));
+void setRenderThreads(int threads)
+{
+    if (threads < 1)
+    {
+        threads = std::max(1, (int)std::thread::hardware_concurrency());
+    }
+    pool.reset(new ThreadPool(threads));
+}
 
-        // which box of the map we're in
-        sf::Vector2i mapPos(rayPos);
-        // what direction to step in (+1 or -1 for each dimension)
-        sf::Vector2i step;
-        // distance from current position to next gridline, for x and y separately
-        sf::Vector2f sideDist;
+int getRenderThreads()
+{
+    return pool ? pool->size() : 1;
+}
 
-        // calculate step and initial sideDist
-        if (rayDir.x < 0.0f)
-        {
-            step.x = -1;
-            sideDist.x = (rayPos.x - mapPos.x) * deltaDist.x;
-        }
-        else
-        {
-            step.x = 1;
-            sideDist.x = (mapPos.x + 1.0f - rayPos.x) * deltaDist.x;
-        }
-        if (rayDir.y < 0.0f)
-        {
-            step.y = -1;
-            sideDist.y = (rayPos.y - mapPos.y) * deltaDist.y;
-        }
+ThreadPool &getRenderPool()
+{
+    if (!pool)
+    {
+        setRenderThreads(0);
+    }
+    return *pool;
+}
+
+RenderStats getRenderStats()
+{
+    return RenderStats{frameSteps, frameLines, getVisibleSprites(), frameReused, rayCount};
+}
+
+// first screen column of ray r of rays, the ray is drawn up to the first column of the next one
+static int getRayColumn(int r, int rays)
+{
+    return (int)((long)r * screenWidth / rays);
+}
+
+// direction of ray r of rays, through the middle of its columns. With a ray per column, through the
+// left edge of the column as it always was.
+static sf::Vector2f getRayDirection(int r, int rays, sf::Vector2f direction, sf::Vector2f plane)
+{
+    int first = getRayColumn(r, rays);
+    float x = first + (getRayColumn(r + 1, rays) - first - 1) * 0.5f;
+    float cameraX = 2 * x / (float)screenWidth - 1.0f; // x in camera space (between -1 and +1)
+    return direction + plane * cameraX;
+}
+
+static void storeHit(RayHit &hit, const RayPacket &packet, int i)
+{
+    hit.dir = sf::Vector2f(packet.dirX[i], packet.dirY[i]);
+    hit.mapPos = sf::Vector2i(packet.mapX[i], packet.mapY[i]);
+    hit.tile = packet.tile[i];
+    hit.horizontal = packet.horizontal[i];
+    hit.distance = packet.distance[i];
+    hit.wall_x = packet.wall_x[i];
+    hit.tex_x = packet.tex_x[i];
+}
+
+static float cross(sf::Vector2f a, sf::Vector2f b)
+{
+    return a.x * b.y - a.y * b.x;
+}
+
+// last of the rays of the last frame that doesn't come after rayDir on the screen, -1 if all of them do.
+// order: sign of the cross product of a ray and the ray right of it.
+// from: a ray that doesn't come after rayDir, or -1
+static int findRayBefore(const RayHit *hits, int rays, sf::Vector2f rayDir, float order, int from)
+{
+    int low = from;
+    int high = rays - 1;
+    while (low < high)
+    {
+        int middle = (low + high + 1) / 2;
+        if (order * cross(hits[middle].dir, rayDir) >= 0.0f)
+            low = middle;
         else
-        {
-            step.y = 1;
-            sideDist.y = (mapPos.y + 1.0f - rayPos.y) * deltaDist.y;
-        }
+            high = middle - 1;
+    }
+    return low;
+}
 
-        // tile type that got hit
-        char tile = '.';
-        // did we hit a horizontal side? Otherwise it's vertical
-        bool horizontal;
-        // wall distance, projected on camera direction
-        float distance = 0.0f;
-        // height of wall to draw on the screen at each distance
-        int wallHeight;
-        // position of ceiling pixel on the screen
-        int ceilingPixel = 0;
-        // position of ground pixel on the screen
-        int groundPixel = screenHeight;
-
-        // cast the ray until we hit a wall, meanwhile draw floors
-        while (tile == '.')
-        {
-            if (sideDist.x < sideDist.y)
-            {
-                sideDist.x += deltaDist.x;
-                mapPos.x += step.x;
-                horizontal = true;
-                distance = (mapPos.x - rayPos.x + (1 - step.x) / 2) / rayDir.x;
-            }
-            else
-            {
-                sideDist.y += deltaDist.y;
-                mapPos.y += step.y;
-                horizontal = false;
-                distance = (mapPos.y - rayPos.y + (1 - step.y) / 2) / rayDir.y;
-            }
+// did two rays hit the same face of the same tile?
+static bool isSameFace(const RayHit &a, const RayHit &b)
+{
+    bool same_side = a.horizontal ? (a.dir.x < 0.0f) == (b.dir.x < 0.0f) : (a.dir.y < 0.0f) == (b.dir.y < 0.0f);
+    return a.mapPos == b.mapPos && a.horizontal == b.horizontal && same_side;
+}
 
-            // calculat height of the wall
-            wallHeight = screenHeight / distance;
+// is a feature on in the kernels for Features? The generic kernels look at the settings every time.
+template <unsigned Features>
+static inline bool hasFeature(unsigned feature)
+{
+    return Features == render_dynamic_features ? (renderFeatures & feature) != 0 : (Features & feature) != 0;
+}
 
-            // colors of the floor
-            sf::Color cell_color = sf::Color::White;
-            cell_color.r /= distance;
-            cell_color.g /= distance;
-            cell_color.b /= distance;
+// draw vertical screen lines first to end - 1 from what their ray hit, with the features of Features
+// into a Backend
+template <unsigned Features, typename Backend>
+static void renderColumns(RenderBackend &target, int first, int end, const RayHit &hit)
+{
+    Backend &backend = static_cast<Backend &>(target);
+    sf::Vector2f rayPos = framePosition;
+    sf::Vector2f rayDir = hit.dir;
+    sf::Vector2i mapPos = hit.mapPos;
 
-            // colors of the ceiling
-            sf::Color floor_color = color_brick;
-            floor_color.r /= distance;
-            floor_color.g /= distance;
-            floor_color.b /= distance;
+    // tile type that got hit
+    char tile = hit.tile;
+    // did we hit a horizontal side? Otherwise it's vertical
+    bool horizontal = hit.horizontal;
+    // wall distance, projected on camera direction
+    float distance = hit.distance;
+    // height of wall to draw on the screen
+    int wallHeight = screenHeight / distance;
 
-            // add floor
-            floorlines.append(sf::Vertex(sf::Vector2f((float)x, (float)groundPixel), floor_color));
-            groundPixel = int(wallHeight * cameraHeight + screenHeight * 0.5f);
-            floorlines.append(sf::Vertex(sf::Vector2f((float)x, (float)groundPixel), floor_color));
+    // calculate lowest and highest pixel to fill in current line
+    int drawStart = int(-wallHeight * (1.0f - cameraHeight) + screenHeight * 0.5f);
+    int drawEnd = int(wallHeight * cameraHeight + screenHeight * 0.5f);
 
-            // add ceiling
-            floorlines.append(sf::Vertex(sf::Vector2f((float)x, (float)ceilingPixel), cell_color));
-            ceilingPixel = int(-wallHeight * (1.0f - cameraHeight) + screenHeight * 0.5f);
-            floorlines.append(sf::Vertex(sf::Vector2f((float)x, (float)ceilingPixel), cell_color));
+    // get position of the wall texture in the full texture
+    int wallTextureNum = (int)getWallTexture(tile);
+    sf::Vector2i texture_coords(
+        wallTextureNum * texture_wall_size % texture_size,
+        wallTextureNum * texture_wall_size / texture_size * texture_wall_size);
 
-            tile = getTile(mapPos.x, mapPos.y);
-        }
+    // where the wall was hit and x coordinate on the wall texture
+    float wall_x = hit.wall_x;
+    texture_coords.x += hit.tex_x;
+    // a door that opens or closes is slid aside, the part of the doorway it uncovers is dark
+    bool uncovered = false;
+    if (getTileAttributes(tile) & tile_door)
+    {
+        int slide = (int)(getDoorOpening(mapPos.x, mapPos.y) * texture_wall_size);
+        uncovered = hit.tex_x < slide;
+        texture_coords.x -= uncovered ? 0 : slide;
+    }
 
-        // add rays to map lines
-        maplines.append(sf::Vertex(sf::Vector2f(10 + (map_scale - 3) / 2 + rayPos.x * (map_scale - 0.1),
-                                                10 + (map_scale - 3) / 2 + rayPos.y * (map_scale - 0.1)),
-                                   sf::Color::Magenta));
-        maplines.append(sf::Vertex(sf::Vector2f(10 + (map_scale - 3) / 2 + (rayPos.x + distance * rayDir.x) * (map_scale - 0.1),
-                                    10 + (map_scale - 3) / 2 + (rayPos.y + distance * rayDir.y) * (map_scale - 0.1)),
-                       sf::Color::Black));
-
-        // calculate lowest and highest pixel to fill in current line
-        int drawStart = ceilingPixel;
-        int drawEnd = groundPixel;
-
-        // get position of the wall texture in the full texture
-        int wallTextureNum = (int)wallTypes.find(tile)->second;
-        sf::Vector2i texture_coords(
-            wallTextureNum * texture_wall_size % texture_size,
-            wallTextureNum * texture_wall_size / texture_size * texture_wall_size);
-
-        // calculate where the wall was hit
-        float wall_x;
-        if (horizontal)
-        {
-            wall_x = rayPos.y + distance * rayDir.y;
-        }
-        else
-        {
-            wall_x = rayPos.x + distance * rayDir.x;
-        }
-        wall_x -= floor(wall_x);
+    // the channels are the same until the lamps light them, so they are shaded as one level
+    int level = 255;
+    // illusion of shadows by making horizontal walls darker
+    if (hasFeature<Features>(render_shading))
+    {
+        level = horizontal ? (int)(255 / 1.2) : 255;
+    }
+    // dynamic shadows on the walls (more dark color on distance)
+    if (hasFeature<Features>(render_fog))
+    {
+        float fogged = level - (distance * 40);
+        level = fogged > 0 ? (int)fogged : 0;
+    }
+    sf::Color color(level, level, level);
 
-        // get x coordinate on the wall texture
-        int tex_x = int(wall_x * float(texture_wall_size));
+    // light of the lamps around, baked for the face of the wall that got hit. The channels wrap around
+    // past 255.
+    if (hasFeature<Features>(render_lighting) && distance > 1)
+    {
+        WallFace face = horizontal ? (rayDir.x > 0 ? WallFace::West : WallFace::East)
+                                   : (rayDir.y > 0 ? WallFace::North : WallFace::South);
+        FaceLight light = getFaceLight(mapPos.x, mapPos.y, face);
+        float glow = light.base + light.slope * wall_x;
+        color.r = (sf::Uint8)(int)(level + (distance * 6 * glow));
+        color.g = (sf::Uint8)(int)(level + (distance * 5 * glow));
+        color.b = (sf::Uint8)(int)(level + (distance * 3 * glow));
+    }
+    if (uncovered)
+    {
+        color = sf::Color::Black;
+    }
 
-        // flip texture if we see it on the other side of us, this prevents a mirrored effect for the texture
-        if ((horizontal && rayDir.x <= 0) || (!horizontal && rayDir.y >= 0))
-        {
-            tex_x = texture_wall_size - tex_x - 1;
-        }
+    for (int x = first; x < end; ++x)
+    {
+        columnDepth[x] = distance;
+        // add ray to the minimap
+        backend.mapRay(x, rayPos, rayPos + rayDir * distance);
+        // add line of the wall
+        backend.wallSpan(x, drawStart, drawEnd, texture_coords, color);
+    }
+}
+
+// draw screen row y of the floor or the ceiling
+template <unsigned Features, typename Backend>
+static void renderRow(RenderBackend &target, int y, sf::Vector2f rayPos, sf::Vector2f direction, sf::Vector2f plane)
+{
+    Backend &backend = static_cast<Backend &>(target);
+    const int horizon = getHorizon();
+    bool ceiling = y < horizon;
+    // distance at which a wall reaches the middle of this row, it's where the row meets the floor or ceiling
+    float distance = ceiling ? screenHeight * (1.0f - cameraHeight) / (horizon - (y + 0.5f))
+                             : screenHeight * cameraHeight / (y + 0.5f - horizon);
+
+    // darker on distance, floor in the color of bricks
+    sf::Color color = ceiling ? sf::Color::White : color_brick;
+    if (hasFeature<Features>(render_fog))
+    {
+        color.r /= distance;
+        color.g /= distance;
+        color.b /= distance;
+    }
+
+    // rays of the left and right edge of the screen
+    backend.floorRow(y, rayPos + (direction - plane) * distance, rayPos + (direction + plane) * distance, color);
+}
+
+// kernels of one feature set for one backend
+struct RenderKernels
+{
+    void (*columns)(RenderBackend &backend, int first, int end, const RayHit &hit);
+    void (*row)(RenderBackend &backend, int y, sf::Vector2f rayPos, sf::Vector2f direction, sf::Vector2f plane);
+};
+
+template <unsigned Features, typename Backend>
+static constexpr RenderKernels makeKernels()
+{
+    return RenderKernels{renderColumns<Features, Backend>, renderRow<Features, Backend>};
+}
+
+// kernels of every feature set for a backend, indexed by the feature bits
+template <typename Backend, unsigned... Features>
+static constexpr std::array<RenderKernels, render_feature_sets> makeKernelTable(std::integer_sequence<unsigned, Features...>)
+{
+    return {{makeKernels<Features, Backend>()...}};
+}
+
+// kernels of every kind of backend, other backends take the ones of RenderBackend
+static const std::array<RenderKernels, render_feature_sets> kernelTables[BackendKinds] = {
+    makeKernelTable<RenderBackend>(std::make_integer_sequence<unsigned, render_feature_sets>()),
+    makeKernelTable<Framebuffer>(std::make_integer_sequence<unsigned, render_feature_sets>()),
+    makeKernelTable<SfmlBackend>(std::make_integer_sequence<unsigned, render_feature_sets>()),
+};
+// features looked up per column, spans through virtual calls
+static const RenderKernels genericKernels = makeKernels<render_dynamic_features, RenderBackend>();
+
+static const RenderKernels &getKernels(RenderBackend &backend)
+{
+    if (!specializedKernels)
+    {
+        return genericKernels;
+    }
+    return kernelTables[backend.getKind()][renderFeatures];
+}
+
+void render(RenderBackend &backend)
+{
+    render(backend, getPlayerState());
+}
 
-        texture_coords.x += tex_x;
+void render(RenderBackend &backend, const PlayerState &camera)
+{
+    ThreadPool &workers = getRenderPool();
 
-        // illusion of shadows by making horizontal walls darker
-        sf::Color color = sf::Color::White;
-        if (horizontal)
+    const int slices = (screenWidth + render_slice_width - 1) / render_slice_width;
+    backend.beginFrame(screenWidth, screenHeight, render_slice_width);
+    const RenderKernels &kernels = getKernels(backend);
+    frameSteps = 0;
+    frameLines = 0;
+
+    const sf::Vector2f rayPos = camera.position;
+    const sf::Vector2f direction = camera.direction;
+    const sf::Vector2f plane = camera.plane;
+    framePosition = rayPos;
+
+    // floor and ceiling first, the walls are drawn over them. The map position seen along a row changes
+    // linearly, so every row is one span, no matter how far it reaches.
+    const int row_blocks = (screenHeight + render_slice_width - 1) / render_slice_width;
+    workers.run(row_blocks, [&](int block) {
+        PROFILE_SCOPE(Stage::Rows);
+        int end = std::min((block + 1) * render_slice_width, screenHeight);
+        for (int y = block * render_slice_width; y < end; ++y)
         {
-            color.r /= 1.2;
-            color.g /= 1.2;
-            color.b /= 1.2;
+            kernels.row(backend, y, rayPos, direction, plane);
         }
+    });
+
+    // the hits of the last frame are kept if nothing they depend on changed, and read while the new ones
+    // are written if only the camera turned
+    const int rays = rayCount;
+    bool same_place = reuseHits && hitsValid && rays == hitsRays && rayPos == hitsPosition &&
+                      getMapVersion() == hitsMapVersion;
+    bool still = same_place && direction == hitsDirection && plane == hitsPlane;
+    bool turned = same_place && !still;
+    if (!still)
+    {
+        currentHits ^= 1;
+    }
+    const RayHit *lastHits = rayHits[currentHits ^ 1].data();
+    RayHit *hits = rayHits[currentHits].data();
+    const float order = cross(hitsDirection, hitsPlane);
+    const sf::Vector2f lastDirection = hitsDirection;
+    frameReused = 0;
 
-        // dynamic shadows on the walls (more dark color on distance)
-        (color.r - (distance * 40)) > 0 ? color.r -= (distance * 40) : color.r = 0;
-        (color.g - (distance * 40)) > 0 ? color.g -= (distance * 40) : color.g = 0;
-        (color.b - (distance * 40)) > 0 ? color.b -= (distance * 40) : color.b = 0;
+    // cast the rays, draw a line of wall for each of their screen columns.
+    // Rays don't depend on each other, so slices of them are cast in parallel,
+    // adjacent rays of a slice are cast together as one ray packet.
+    const int ray_slices = (rays + render_slice_width - 1) / render_slice_width;
+    workers.run(ray_slices, [&](int slice) {
+        PROFILE_SCOPE(Stage::Walls);
+        thread_local RayPacket packet;
+        // rays of the packet that have to be cast, and their lanes in it
+        thread_local RayPacket missed;
+        int missedLanes[RayPacket::size];
+        missed.stepsTaken = 0;
+        missed.linesCrossed = 0;
+        long reused = 0;
 
-        // very basic dynamic ligthinig
-        for (int i = -1; i < 2; i++)
+        int end = std::min((slice + 1) * render_slice_width, rays);
+        int before = -1;
+        for (int first = slice * render_slice_width; first < end; first += RayPacket::size)
         {
-            for (int j = -1; j < 2; j++)
+            int count = std::min(RayPacket::size, end - first);
+            if (still)
             {
-                if ((getTile(mapPos.x + i, mapPos.y + j) == '5') && distance > 1)
+                reused += count;
+            }
+            else
+            {
+                int misses = 0;
+                for (int i = 0; i < count; ++i)
                 {
-                    if (tile == '5')
-                    {
-                        color.r += (distance * 6);
-                        color.g += (distance * 5);
-                        color.b += (distance * 3);
-                    }
-                    else
+                    // ray to emit
+                    sf::Vector2f rayDir = getRayDirection(first + i, rays, direction, plane);
+                    packet.dirX[i] = rayDir.x;
+                    packet.dirY[i] = rayDir.y;
+
+                    // between two rays of the last frame that hit the same face, nothing else can be in
+                    // the way: a tile in between would have to be narrower than the face
+                    if (turned && lastDirection.x * rayDir.x + lastDirection.y * rayDir.y > 0.0f)
                     {
-                        color.r += distance * 6 * ((j == 1 || i == 1) ? wall_x : (1 - wall_x));
-                        color.g += distance * 5 * ((j == 1 || i == 1) ? wall_x : (1 - wall_x));
-                        color.b += distance * 3 * ((j == 1 || i == 1) ? wall_x : (1 - wall_x));
+                        before = findRayBefore(lastHits, rays, rayDir, order, before);
+                        if (before >= 0 && before + 1 < rays && isSameFace(lastHits[before], lastHits[before + 1]))
+                        {
+                            hitFace(rayPos, packet, i, lastHits[before].mapPos, lastHits[before].horizontal);
+                            storeHit(hits[first + i], packet, i);
+                            ++reused;
+                            continue;
+                        }
                     }
+                    missed.dirX[misses] = rayDir.x;
+                    missed.dirY[misses] = rayDir.y;
+                    missedLanes[misses++] = i;
                 }
+                castRays(rayPos, missed, misses);
+                for (int i = 0; i < misses; ++i)
+                {
+                    storeHit(hits[first + missedLanes[i]], missed, i);
+                }
+            }
+
+            for (int i = 0; i < count; ++i)
+            {
+                kernels.columns(backend, getRayColumn(first + i, rays), getRayColumn(first + i + 1, rays), hits[first + i]);
             }
         }
+        frameSteps += missed.stepsTaken;
+        frameLines += missed.linesCrossed;
+        frameReused += reused;
+    });
+    hitsValid = true;
+    hitsRays = rays;
+    hitsPosition = rayPos;
+    hitsDirection = direction;
+    hitsPlane = plane;
+    hitsMapVersion = getMapVersion();
 
-        // add line to vertex buffer of walls
-        lines.append(sf::Vertex(
-            sf::Vector2f((float)x, (float)drawStart),
-            color,
-            sf::Vector2f((float)texture_coords.x, (float)texture_coords.y + 1)));
-        lines.append(sf::Vertex(
-            sf::Vector2f((float)x, (float)drawEnd),
-            color,
-            sf::Vector2f((float)texture_coords.x, (float)(texture_coords.y + texture_wall_size - 1))));
+    // sprites over the walls, in slices of screen columns
+    {
+        PROFILE_SCOPE(Stage::Sprites);
+        cullSprites(rayPos, direction, plane, columnDepth.data());
+    }
+    if (getVisibleSprites() > 0)
+    {
+        workers.run(slices, [&](int slice) {
+            PROFILE_SCOPE(Stage::Sprites);
+            renderSprites(backend, slice * render_slice_width, std::min((slice + 1) * render_slice_width, screenWidth),
+                          columnDepth.data());
+        });
     }
-}
 
-sf::VertexArray getLines()
-{
-    return lines;
+    PROFILE_SCOPE(Stage::Handoff);
+    backend.endFrame();
 }
 
-sf::VertexArray getMapLines()
+int checkRayReuse()
 {
-    return maplines;
-}
-
-sf::VertexArray getFloorLines()
-{
-    return floorlines;
+    if (!hitsValid)
+    {
+        return 0;
+    }
+    RayPacket packet;
+    int differ = 0;
+    for (int first = 0; first < hitsRays; first += RayPacket::size)
+    {
+        int count = std::min(RayPacket::size, hitsRays - first);
+        for (int i = 0; i < count; ++i)
+        {
+            sf::Vector2f rayDir = getRayDirection(first + i, hitsRays, hitsDirection, hitsPlane);
+            packet.dirX[i] = rayDir.x;
+            packet.dirY[i] = rayDir.y;
+        }
+        castRays(hitsPosition, packet, count);
+        for (int i = 0; i < count; ++i)
+        {
+            RayHit cast;
+            storeHit(cast, packet, i);
+            const RayHit &hit = rayHits[currentHits][first + i];
+            differ += hit.dir != cast.dir || hit.mapPos != cast.mapPos || hit.tile != cast.tile ||
+                      hit.horizontal != cast.horizontal || hit.distance != cast.distance || hit.wall_x != cast.wall_x ||
+                      hit.tex_x != cast.tex_x;
+        }
+    }
+    return differ;
 }
-
-void clearAllLines()
-{
-    lines.clear();
-    floorlines.clear();
-    maplines.clear();
-}
\ No newline at end of file
@@ -1,26 +1,110 @@
 #ifndef Engine_hpp
 #define Engine_hpp
 #include <SFML/Graphics.hpp>
+#include "Map.h"
 #include "Player.h"
+#include "Backend.h"
 
-// screen width
-const int screenWidth = 1280;
-// screen height
-const int screenHeight = 768;
+class ThreadPool;
+
+// screen size until setResolution() changes it
+const int default_screen_width = 1280;
+const int default_screen_height = 768;
+// smallest screen size setResolution() takes
+const int min_screen_width = 160;
+const int min_screen_height = 96;
 // height of player camera (1.0 is ceiling, 0.0 is floor)
 const float cameraHeight = 0.5f;
 // size of texture plane
 const int texture_size = 512;
 // size of each wall type in the full texture
 const int texture_wall_size = 128;
+// size of each sprite in the sprite texture, the sprites are side by side
+const int sprite_size = 128;
+// textures of the floor and the ceiling, tiles of the full texture repeated over the map
+const WallTexture floor_texture = WallTexture::BigWall;
+const WallTexture ceiling_texture = WallTexture::Wall;
+// number of rays, screen columns or floor rows rendered as one task by the render threads
+const int render_slice_width = 32;
+// frames adaptRayCount() averages before it changes the ray count
+const int ray_adapt_frames = 8;
+// adaptRayCount() adds rays while frames take less than this part of the budget, this many times as many
+const float ray_headroom = 0.75f;
+const float ray_raise = 1.1f;
+// adaptRayCount() casts at least one ray per this many screen columns
+const int ray_min_divisor = 8;
 
 // colors
 const sf::Color color_brick(85, 55, 50);
 
-void render();
-sf::VertexArray getLines();
-sf::VertexArray getMapLines();
-sf::VertexArray getFloorLines();
-void clearAllLines();
+// render a frame of the game as it is now, seen by the player
+void render(RenderBackend &backend);
+// render it seen by camera, the player itself isn't read. The map, entities, doors and the settings of the
+// renderer are, they can't change until render() returns.
+void render(RenderBackend &backend, const PlayerState &camera);
+
+// features of render(), bits of setRenderFeatures()
+const unsigned render_shading = 1 << 0;  // horizontal walls darker than vertical ones
+const unsigned render_fog = 1 << 1;      // walls, floor and ceiling darker on distance
+const unsigned render_lighting = 1 << 2; // light of the lamps on the walls
+const unsigned render_all_features = render_shading | render_fog | render_lighting;
+const unsigned render_feature_sets = render_all_features + 1;
+// feature set of the generic kernels, which look the features up as they go
+const unsigned render_dynamic_features = render_feature_sets;
+
+// The wall columns and floor rows are drawn by kernels compiled for every feature set and for the
+// framebuffer and window backends, picked per frame, so they don't check features or make virtual calls.
+// All features are on by default.
+void setRenderFeatures(unsigned features);
+unsigned getRenderFeatures();
+// use the generic kernels instead, to compare
+void setKernelSpecialization(bool specialized);
+bool getKernelSpecialization();
+
+// size of the frames render() draws, in pixels. The buffers of the renderer are resized here, once, and
+// the ones of a backend in the first frame it gets at the new size. Sets one ray per screen column.
+void setResolution(int width, int height);
+int getScreenWidth();
+int getScreenHeight();
+// first screen row of the floor, rows above it are ceiling
+int getHorizon();
+// rays cast per frame, between 1 and one per screen column. Each ray is drawn over the screen columns
+// up to the next one, fewer rays make wider columns.
+void setRayCount(int rays);
+int getRayCount();
+// frame time in seconds adaptRayCount() keeps the frames under, 0 keeps the ray count as it is
+void setFrameBudget(float seconds);
+float getFrameBudget();
+// time the last frame took, in seconds. Every ray_adapt_frames frames the ray count goes down if they
+// took longer than the budget on average, and up again if there is headroom.
+void adaptRayCount(float frame_seconds);
+// number of threads used by render(), 0 picks one per hardware thread
+void setRenderThreads(int threads);
+int getRenderThreads();
+// threads of render(), the simulation uses them too between frames
+ThreadPool &getRenderPool();
+
+// ray statistics of the last frame rendered
+struct RenderStats
+{
+    // DDA steps taken by all rays
+    long raySteps;
+    // grid lines crossed by them, the steps it would take without skipping empty space
+    long linesCrossed;
+    // sprites in view, at least partly in front of the walls
+    long sprites;
+    // rays taken over from the frame before, without casting them
+    long reusedRays;
+    // rays cast or taken over
+    int rays;
+};
+RenderStats getRenderStats();
+
+// take over the rays of the frame before while the player stands still or only turns, on by default
+void setRayReuse(bool reuse);
+bool getRayReuse();
+// cast the rays of the last frame again and count the ones that hit something else than the rays
+// render() drew, taken over or not
+int checkRayReuse();
 
 #endif
\ No newline at end of file
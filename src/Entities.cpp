@@ -0,0 +1,134 @@
+#include "Entities.h"
+#include <algorithm>
+#include <vector>
+
+static std::vector<Entity> entities;
+// next and previous entity in the cell of every entity, -1 at the ends
+static std::vector<int> nextInCell;
+static std::vector<int> previousInCell;
+// first entity of every cell, row by row
+static std::vector<int> cellFirst;
+static int cellsX = 0;
+static int cellsY = 0;
+
+static int getCell(sf::Vector2f position)
+{
+    int x = std::min(std::max((int)position.x >> entity_cell_shift, 0), cellsX - 1);
+    int y = std::min(std::max((int)position.y >> entity_cell_shift, 0), cellsY - 1);
+    return y * cellsX + x;
+}
+
+static void link(int id)
+{
+    int &first = cellFirst[getCell(entities[id].position)];
+    nextInCell[id] = first;
+    previousInCell[id] = -1;
+    if (first >= 0)
+    {
+        previousInCell[first] = id;
+    }
+    first = id;
+}
+
+static void unlink(int id)
+{
+    int next = nextInCell[id];
+    int previous = previousInCell[id];
+    if (next >= 0)
+    {
+        previousInCell[next] = previous;
+    }
+    if (previous >= 0)
+    {
+        nextInCell[previous] = next;
+    }
+    else
+    {
+        cellFirst[getCell(entities[id].position)] = next;
+    }
+}
+
+void clearEntities()
+{
+    entities.clear();
+    nextInCell.clear();
+    previousInCell.clear();
+    cellsX = (getMapWidth() + entity_cell_size - 1) >> entity_cell_shift;
+    cellsY = (getMapHeight() + entity_cell_size - 1) >> entity_cell_shift;
+    cellFirst.assign((size_t)cellsX * cellsY, -1);
+}
+
+int addEntity(sf::Vector2f position, SpriteTexture sprite)
+{
+    int id = entities.size();
+    entities.push_back(Entity{position, sprite});
+    nextInCell.push_back(-1);
+    previousInCell.push_back(-1);
+    link(id);
+    return id;
+}
+
+void moveEntity(int id, sf::Vector2f position)
+{
+    if (getCell(position) == getCell(entities[id].position))
+    {
+        entities[id].position = position;
+        return;
+    }
+    unlink(id);
+    entities[id].position = position;
+    link(id);
+}
+
+void scatterEntities(int count, unsigned seed)
+{
+    // linear congruential generator, the same sequence everywhere
+    auto random = [&seed](int range) {
+        seed = seed * 1103515245u + 12345u;
+        return (int)((seed >> 8) % (unsigned)range);
+    };
+
+    entities.reserve(entities.size() + count);
+    nextInCell.reserve(nextInCell.size() + count);
+    previousInCell.reserve(previousInCell.size() + count);
+    for (int placed = 0, tries = 0; placed < count && tries < count * 100; ++tries)
+    {
+        int x = random(getMapWidth());
+        int y = random(getMapHeight());
+        if (!isSolid(x, y))
+        {
+            addEntity(sf::Vector2f(x + 0.5f, y + 0.5f), SpriteTexture::Bush);
+            ++placed;
+        }
+    }
+}
+
+int getEntityCount()
+{
+    return entities.size();
+}
+
+const Entity &getEntity(int id)
+{
+    return entities[id];
+}
+
+int getEntityCellsX()
+{
+    return cellsX;
+}
+
+int getEntityCellsY()
+{
+    return cellsY;
+}
+
+int getCellEntity(int cell_x, int cell_y)
+{
+    return cellFirst[cell_y * cellsX + cell_x];
+}
+
+int getNextEntity(int id)
+{
+    return nextInCell[id];
+}
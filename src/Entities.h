@@ -0,0 +1,42 @@
+#ifndef Entities_hpp
+#define Entities_hpp
+#include <SFML/Graphics.hpp>
+#include "Map.h"
+
+// sprites in the sprite texture, side by side
+enum class SpriteTexture
+{
+    Bush
+};
+
+// thing standing on the map, drawn as a sprite
+struct Entity
+{
+    sf::Vector2f position; // middle of its foot, in map coordinates
+    SpriteTexture sprite;
+};
+
+// Entities are sorted into a uniform grid of square cells over the map, so the renderer only looks at
+// the cells in view. Each cell is a doubly linked list through the entities, moving one doesn't allocate.
+const int entity_cell_shift = 3;
+const int entity_cell_size = 1 << entity_cell_shift;
+
+// remove all entities and fit the grid to the loaded map
+void clearEntities();
+// returns: id of the entity, ids count up from 0
+int addEntity(sf::Vector2f position, SpriteTexture sprite);
+void moveEntity(int id, sf::Vector2f position);
+// add count entities on random floor tiles, the same ones for the same seed and map, all of them bushes
+void scatterEntities(int count, unsigned seed);
+
+int getEntityCount();
+const Entity &getEntity(int id);
+
+// cells of the grid in a row and in a column
+int getEntityCellsX();
+int getEntityCellsY();
+// first entity of a cell, then the next one after an entity in the same cell, -1 at the end
+int getCellEntity(int cell_x, int cell_y);
+int getNextEntity(int id);
+
+#endif
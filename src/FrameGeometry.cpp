@@ -0,0 +1,40 @@
+#include "FrameGeometry.h"
+
+static void resizeFrame(FrameVertices &frame, int width, int height)
+{
+    frame.walls.resize(width * 2);
+    frame.rows.resize(height * 2);
+    frame.rays.resize(width * 2);
+}
+
+FrameGeometry::FrameGeometry(int width, int height)
+{
+    for (FrameVertices &frame : frames)
+    {
+        resizeFrame(frame, width, height);
+    }
+}
+
+void FrameGeometry::resizeBack(int width, int height)
+{
+    FrameVertices &back = getBack();
+    if (back.walls.size() != (size_t)width * 2 || back.rows.size() != (size_t)height * 2)
+    {
+        resizeFrame(back, width, height);
+    }
+}
+
+FrameVertices &FrameGeometry::getBack()
+{
+    return frames[1 - front];
+}
+
+const FrameVertices &FrameGeometry::getFront() const
+{
+    return frames[front];
+}
+
+void FrameGeometry::swap()
+{
+    front = 1 - front;
+}
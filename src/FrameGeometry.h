@@ -0,0 +1,42 @@
+#ifndef FrameGeometry_hpp
+#define FrameGeometry_hpp
+#include <SFML/Graphics.hpp>
+#include <vector>
+
+// vertices of one frame for the window. Every buffer but the sprites has a fixed size, sized from the
+// resolution when it changes, and is written by index. Sprite lines are appended and keep their capacity, so frames only
+// allocate when they show more sprites than any frame before.
+struct FrameVertices
+{
+    // lines of walls, two vertices per screen column
+    std::vector<sf::Vertex> walls;
+    // lines of the ceiling rows and then the floor rows, two vertices per screen row
+    std::vector<sf::Vertex> rows;
+    // rays on the minimap, two vertices per screen column, in the coordinates of Minimap tiles
+    std::vector<sf::Vertex> rays;
+    // lines of sprites, two vertices per sprite column, one list per slice of columns so the slices can
+    // be written at the same time
+    std::vector<std::vector<sf::Vertex>> sprites;
+};
+
+// two frames of vertices: the back frame is built by the renderer while the front frame, the last one
+// finished, is drawn
+class FrameGeometry
+{
+public:
+    FrameGeometry(int width, int height);
+
+    // size the back frame for width x height pixels, if it isn't already
+    void resizeBack(int width, int height);
+
+    FrameVertices &getBack();
+    const FrameVertices &getFront() const;
+    // the back frame is finished, make it the front one
+    void swap();
+
+private:
+    FrameVertices frames[2];
+    int front = 0;
+};
+
+#endif
@@ -0,0 +1,198 @@
+#include "Framebuffer.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include "Engine.h"
+
+Framebuffer::Framebuffer(int width, int height)
+    : RenderBackend(FramebufferBackend), width(width), height(height), pixels(width * height * 4)
+{
+}
+
+bool Framebuffer::loadTexture(const std::string &file)
+{
+    return texture.loadFromFile(file) && walls.build(texture);
+}
+
+void Framebuffer::setWallMipmaps(bool enabled)
+{
+    mipmaps = enabled;
+}
+
+const WallTextures &Framebuffer::getWallTextures() const
+{
+    return walls;
+}
+
+bool Framebuffer::loadSpriteTexture(const std::string &file)
+{
+    return sprites.loadFromFile(file);
+}
+
+bool Framebuffer::savePPM(const std::string &file) const
+{
+    FILE *out = fopen(file.c_str(), "wb");
+    if (!out)
+    {
+        return false;
+    }
+    fprintf(out, "P6\n%d %d\n255\n", width, height);
+    for (int i = 0; i < width * height; ++i)
+    {
+        fwrite(&pixels[i * 4], 1, 3, out);
+    }
+    return fclose(out) == 0;
+}
+
+void Framebuffer::beginFrame(int frame_width, int frame_height, int)
+{
+    if (frame_width != width || frame_height != height)
+    {
+        width = frame_width;
+        height = frame_height;
+        pixels.resize((size_t)width * height * 4);
+    }
+    // same as window.clear(), opaque black. Columns of different slices never share a pixel,
+    // so spans can be written from all render threads without locking.
+    for (size_t i = 0; i < pixels.size(); i += 4)
+    {
+        pixels[i] = pixels[i + 1] = pixels[i + 2] = 0;
+        pixels[i + 3] = 255;
+    }
+}
+
+void Framebuffer::floorRow(int y, sf::Vector2f from, sf::Vector2f to, sf::Color color)
+{
+    if (y < 0 || y >= height)
+    {
+        return;
+    }
+    WallTexture type = y < height / 2 ? ceiling_texture : floor_texture;
+    const int tile_x = (int)type * texture_wall_size % texture_size;
+    const int tile_y = (int)type * texture_wall_size / texture_size * texture_wall_size;
+
+    // map position of each pixel center in texels, stepped in 16.16 fixed point. The position wraps around
+    // in 32 bits, which keeps it on the same texel of the repeated tile.
+    const double scale = texture_wall_size * 65536.0;
+    sf::Vector2f step = (to - from) / (float)width;
+    int64_t tex_x = llround((from.x + step.x * 0.5) * scale);
+    int64_t tex_y = llround((from.y + step.y * 0.5) * scale);
+    const int64_t tex_step_x = llround(step.x * scale);
+    const int64_t tex_step_y = llround(step.y * scale);
+
+    const sf::Uint8 *texels = texture.getPixelsPtr();
+    const int texture_width = texture.getSize().x;
+    sf::Uint8 *pixel = &pixels[y * width * 4];
+    for (int x = 0; x < width; ++x, pixel += 4, tex_x += tex_step_x, tex_y += tex_step_y)
+    {
+        int u = ((uint32_t)tex_x >> 16) & (texture_wall_size - 1);
+        int v = ((uint32_t)tex_y >> 16) & (texture_wall_size - 1);
+        // texture modulated by the vertex color, as SFML does
+        const sf::Uint8 *texel = &texels[((tile_y + v) * texture_width + tile_x + u) * 4];
+        pixel[0] = texel[0] * color.r / 255;
+        pixel[1] = texel[1] * color.g / 255;
+        pixel[2] = texel[2] * color.b / 255;
+    }
+}
+
+void Framebuffer::wallSpan(int x, int draw_start, int draw_end, sf::Vector2i texture_coords, sf::Color color)
+{
+    int span = draw_end - draw_start;
+    if (span <= 0)
+    {
+        return;
+    }
+    int top = std::max(draw_start, 0);
+    int bottom = std::min(draw_end, height);
+
+    // texture rows run from texture_coords.y + 1 to texture_coords.y + texture_wall_size - 1 along the span,
+    // the same range the SFML backend puts on its line vertices. Stepped in 16.16 fixed point.
+    const int texture_span = texture_wall_size - 2;
+    int64_t tex_step = ((int64_t)texture_span << 16) / span;
+
+    if (mipmaps)
+    {
+        // the column of the tile at the level for the height of the span, in one piece of memory.
+        // Rows are stepped in texels of level 0 and scaled down to the level.
+        const int tiles_per_row = texture_size / texture_wall_size;
+        const int tile = texture_coords.y / texture_wall_size * tiles_per_row + texture_coords.x / texture_wall_size;
+        const int level = WallTextures::getLevel(span);
+        const uint32_t *column = walls.getColumn(tile, level, (texture_coords.x % texture_wall_size) >> level);
+        int64_t row = ((int64_t)1 << 16) + tex_step * (top - draw_start) + tex_step / 2;
+        sf::Uint8 *pixel = &pixels[(top * width + x) * 4];
+        for (int y = top; y < bottom; ++y, pixel += width * 4, row += tex_step)
+        {
+            sf::Uint8 texel[4];
+            memcpy(texel, &column[(row >> 16) >> level], 4);
+            pixel[0] = texel[0] * color.r / 255;
+            pixel[1] = texel[1] * color.g / 255;
+            pixel[2] = texel[2] * color.b / 255;
+        }
+        return;
+    }
+
+    int64_t tex_y = ((int64_t)(texture_coords.y + 1) << 16) + tex_step * (top - draw_start) + tex_step / 2;
+    const sf::Uint8 *texels = texture.getPixelsPtr();
+    const int texture_width = texture.getSize().x;
+    sf::Uint8 *pixel = &pixels[(top * width + x) * 4];
+    for (int y = top; y < bottom; ++y, pixel += width * 4, tex_y += tex_step)
+    {
+        // texture modulated by the vertex color, as SFML does
+        const sf::Uint8 *texel = &texels[((tex_y >> 16) * texture_width + texture_coords.x) * 4];
+        pixel[0] = texel[0] * color.r / 255;
+        pixel[1] = texel[1] * color.g / 255;
+        pixel[2] = texel[2] * color.b / 255;
+    }
+}
+
+void Framebuffer::spriteSpan(int x, int draw_start, int draw_end, sf::Vector2i texture_coords, sf::Color color)
+{
+    int span = draw_end - draw_start;
+    if (span <= 0 || sprites.getSize().y < (unsigned)sprite_size)
+    {
+        return;
+    }
+    int top = std::max(draw_start, 0);
+    int bottom = std::min(draw_end, height);
+
+    // all sprite_size texture rows along the span, in 16.16 fixed point as the walls
+    int64_t tex_step = ((int64_t)sprite_size << 16) / span;
+    int64_t tex_y = ((int64_t)texture_coords.y << 16) + tex_step * (top - draw_start) + tex_step / 2;
+
+    const sf::Uint8 *texels = sprites.getPixelsPtr();
+    const int texture_width = sprites.getSize().x;
+    sf::Uint8 *pixel = &pixels[(top * width + x) * 4];
+    for (int y = top; y < bottom; ++y, pixel += width * 4, tex_y += tex_step)
+    {
+        const sf::Uint8 *texel = &texels[((tex_y >> 16) * texture_width + texture_coords.x) * 4];
+        // alpha tested, the edges of sprites are hard
+        if (texel[3] < 128)
+        {
+            continue;
+        }
+        pixel[0] = texel[0] * color.r / 255;
+        pixel[1] = texel[1] * color.g / 255;
+        pixel[2] = texel[2] * color.b / 255;
+    }
+}
+
+void Framebuffer::mapRay(int, sf::Vector2f, sf::Vector2f)
+{
+    // minimap is part of the window overlay, not of the rendered view
+}
+
+int Framebuffer::getWidth() const
+{
+    return width;
+}
+
+int Framebuffer::getHeight() const
+{
+    return height;
+}
+
+const sf::Uint8 *Framebuffer::getPixels() const
+{
+    return pixels.data();
+}
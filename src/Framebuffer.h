@@ -0,0 +1,47 @@
+#ifndef Framebuffer_hpp
+#define Framebuffer_hpp
+#include <SFML/Graphics.hpp>
+#include <string>
+#include <vector>
+#include "Backend.h"
+#include "WallTextures.h"
+
+// software backend: rasterizes the frame on the CPU into an RGBA framebuffer, so it can be rendered
+// without a window or a GPU
+class Framebuffer final : public RenderBackend
+{
+public:
+    Framebuffer(int width, int height);
+
+    // load the full texture sampled by wallSpan() and floorRow(), and prepare the wall tiles for columns
+    bool loadTexture(const std::string &file);
+    // sample walls from the column mip chains, or from the atlas as it is, to compare
+    void setWallMipmaps(bool enabled);
+    const WallTextures &getWallTextures() const;
+    // load the sprite texture sampled by spriteSpan()
+    bool loadSpriteTexture(const std::string &file);
+    // write the framebuffer as binary PPM
+    bool savePPM(const std::string &file) const;
+
+    void beginFrame(int width, int height, int slice_width) override;
+    void floorRow(int y, sf::Vector2f from, sf::Vector2f to, sf::Color color) override;
+    void wallSpan(int x, int draw_start, int draw_end, sf::Vector2i texture_coords, sf::Color color) override;
+    void spriteSpan(int x, int draw_start, int draw_end, sf::Vector2i texture_coords, sf::Color color) override;
+    void mapRay(int x, sf::Vector2f from, sf::Vector2f to) override;
+
+    int getWidth() const;
+    int getHeight() const;
+    // RGBA pixels, row by row
+    const sf::Uint8 *getPixels() const;
+
+private:
+    int width;
+    int height;
+    std::vector<sf::Uint8> pixels;
+    sf::Image texture;
+    WallTextures walls;
+    bool mipmaps = true;
+    sf::Image sprites;
+};
+
+#endif
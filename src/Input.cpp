@@ -0,0 +1,106 @@
+#include "Input.h"
+#include <stdio.h>
+#include <SFML/Graphics.hpp>
+
+const int input_log_version = 1;
+
+uint8_t pollKeyboard()
+{
+    using kb = sf::Keyboard;
+
+    uint8_t input = 0;
+    if (kb::isKeyPressed(kb::Up))
+        input |= input_forward;
+    else if (kb::isKeyPressed(kb::Down))
+        input |= input_back;
+    if (kb::isKeyPressed(kb::Left))
+        input |= input_left;
+    else if (kb::isKeyPressed(kb::Right))
+        input |= input_right;
+    if (kb::isKeyPressed(kb::LShift))
+        input |= input_strafe;
+    return input;
+}
+
+void InputLog::record(long tick, uint8_t input)
+{
+    if (events.empty() || events.back().input != input)
+    {
+        events.push_back(InputEvent{tick, input});
+    }
+    ticks = tick + 1;
+}
+
+uint8_t InputLog::getInput(long tick) const
+{
+    if (tick >= ticks || events.empty() || tick < events[0].tick)
+    {
+        return 0;
+    }
+    // start over for ticks before the cursor, move on to the last change at or before tick
+    if (cursor >= events.size() || events[cursor].tick > tick)
+    {
+        cursor = 0;
+    }
+    while (cursor + 1 < events.size() && events[cursor + 1].tick <= tick)
+    {
+        ++cursor;
+    }
+    return events[cursor].input;
+}
+
+long InputLog::getTicks() const
+{
+    return ticks;
+}
+
+bool InputLog::load(const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if (!file)
+    {
+        fprintf(stderr, "Cannot open input log %s\n", path);
+        return false;
+    }
+    int version = 0;
+    long count = 0;
+    if (fscanf(file, "R3DI %d %ld", &version, &count) != 2 || version != input_log_version || count < 0)
+    {
+        fprintf(stderr, "%s is not an input log of version %d\n", path, input_log_version);
+        fclose(file);
+        return false;
+    }
+
+    events.clear();
+    long tick;
+    unsigned input;
+    while (fscanf(file, "%ld %u", &tick, &input) == 2)
+    {
+        if (tick < 0 || tick >= count || input > 0xff || (!events.empty() && tick <= events.back().tick))
+        {
+            fprintf(stderr, "%s: event at tick %ld is out of order\n", path, tick);
+            fclose(file);
+            return false;
+        }
+        events.push_back(InputEvent{tick, (uint8_t)input});
+    }
+    fclose(file);
+    ticks = count;
+    cursor = 0;
+    return true;
+}
+
+bool InputLog::save(const char *path) const
+{
+    FILE *file = fopen(path, "w");
+    if (!file)
+    {
+        return false;
+    }
+    fprintf(file, "R3DI %d %ld\n", input_log_version, ticks);
+    for (const InputEvent &event : events)
+    {
+        fprintf(file, "%ld %u\n", event.tick, (unsigned)event.input);
+    }
+    return fclose(file) == 0;
+}
@@ -0,0 +1,45 @@
+#ifndef Input_hpp
+#define Input_hpp
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// input of the player during one simulation tick, bits of the controls held down
+const uint8_t input_forward = 1 << 0;
+const uint8_t input_back = 1 << 1;
+const uint8_t input_left = 1 << 2;  // turn, or step with input_strafe
+const uint8_t input_right = 1 << 3;
+const uint8_t input_strafe = 1 << 4;
+
+// controls held down on the keyboard right now
+uint8_t pollKeyboard();
+
+// input of a session, stored as the ticks the input changed at. Replaying a recording gives every
+// tick the same input it had, so the session runs the same again.
+class InputLog
+{
+public:
+    // input during tick, ticks have to be recorded in order
+    void record(long tick, uint8_t input);
+    // input of tick, none after the end of the log
+    uint8_t getInput(long tick) const;
+    // number of ticks in the log
+    long getTicks() const;
+
+    // text file, "R3DI <version> <ticks>" and then a "<tick> <input>" line for every change
+    bool load(const char *path);
+    bool save(const char *path) const;
+
+private:
+    struct InputEvent
+    {
+        long tick;
+        uint8_t input;
+    };
+    std::vector<InputEvent> events;
+    long ticks = 0;
+    // event of the last getInput() call, replay asks for the ticks in order
+    mutable size_t cursor = 0;
+};
+
+#endif
@@ -0,0 +1,310 @@
+#include "Lightmap.h"
+#include <math.h>
+#include <stdint.h>
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+// light of a face in fixed point, 1.0 is light_one
+struct PackedLight
+{
+    int16_t base;
+    int16_t slope;
+};
+const float light_one = 2048.0f;
+
+// light of the faces of one map chunk
+struct ChunkLight
+{
+    PackedLight faces[chunk_size * chunk_size][4];
+};
+
+// page of every map chunk in pages, -1 for chunks that no lamp reaches.
+// Pages don't move when more are added.
+static std::vector<int> chunkPages;
+static std::deque<ChunkLight> pages;
+// pages of chunks that went dark, taken again before new ones are added
+static std::vector<int> freePages;
+static int chunksX;
+
+// geometry of a face: the tile in front of it, its end at wall_x 0, its direction and outward normal
+struct FaceGeometry
+{
+    sf::Vector2i front;
+    sf::Vector2f start;
+    sf::Vector2f along;
+    sf::Vector2f normal;
+};
+
+static FaceGeometry getFaceGeometry(int x, int y, WallFace face)
+{
+    switch (face)
+    {
+    case WallFace::West:
+        return {sf::Vector2i(x - 1, y), sf::Vector2f(x, y), sf::Vector2f(0, 1), sf::Vector2f(-1, 0)};
+    case WallFace::East:
+        return {sf::Vector2i(x + 1, y), sf::Vector2f(x + 1, y), sf::Vector2f(0, 1), sf::Vector2f(1, 0)};
+    case WallFace::North:
+        return {sf::Vector2i(x, y - 1), sf::Vector2f(x, y), sf::Vector2f(1, 0), sf::Vector2f(0, -1)};
+    default:
+        return {sf::Vector2i(x, y + 1), sf::Vector2f(x, y + 1), sf::Vector2f(1, 0), sf::Vector2f(0, 1)};
+    }
+}
+
+// light of a face, allocates the page of its chunk
+static PackedLight &getLight(int x, int y, WallFace face)
+{
+    int &page = chunkPages[(y >> chunk_shift) * chunksX + (x >> chunk_shift)];
+    if (page < 0 && !freePages.empty())
+    {
+        page = freePages.back();
+        freePages.pop_back();
+        pages[page] = ChunkLight{};
+    }
+    else if (page < 0)
+    {
+        page = pages.size();
+        pages.push_back(ChunkLight{});
+    }
+    return pages[page].faces[(y & chunk_mask) * chunk_size + (x & chunk_mask)][(int)face];
+}
+
+// does the segment from a lamp to a point pass only through empty tiles?
+// The tile of the lamp itself doesn't count.
+static bool isLit(sf::Vector2f from, sf::Vector2f to)
+{
+    sf::Vector2i cell(floor(from.x), floor(from.y));
+    sf::Vector2i end(floor(to.x), floor(to.y));
+    sf::Vector2f dir = to - from;
+    sf::Vector2i step(dir.x < 0 ? -1 : 1, dir.y < 0 ? -1 : 1);
+
+    // same traversal as the rays, with infinity for axes the segment is parallel to
+    sf::Vector2f delta(fabs(1.0f / dir.x), fabs(1.0f / dir.y));
+    sf::Vector2f side(
+        (dir.x < 0 ? from.x - cell.x : cell.x + 1.0f - from.x) * delta.x,
+        (dir.y < 0 ? from.y - cell.y : cell.y + 1.0f - from.y) * delta.y);
+
+    for (int n = abs(end.x - cell.x) + abs(end.y - cell.y); n > 0; --n)
+    {
+        if (side.x < side.y)
+        {
+            side.x += delta.x;
+            cell.x += step.x;
+        }
+        else
+        {
+            side.y += delta.y;
+            cell.y += step.y;
+        }
+        if (isSolid(cell.x, cell.y))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// light of a lamp at a point, fading out linearly from the surface of the lamp to light_range
+static float getLampLight(sf::Vector2f lamp, sf::Vector2f point)
+{
+    sf::Vector2f offset = point - lamp;
+    float distance = sqrt(offset.x * offset.x + offset.y * offset.y) - 0.5f;
+    return std::max(0.0f, 1.0f - distance / light_range);
+}
+
+// add the light of the lamp at lamp_x, lamp_y to the faces of the walls in x0, y0 - x1, y1
+static void bakeLamp(int lamp_x, int lamp_y, int x0, int y0, int x1, int y1)
+{
+    // emit from the middle of the lamp
+    sf::Vector2f lamp(lamp_x + 0.5f, lamp_y + 0.5f);
+    // keeps test points off the grid lines
+    const float margin = 0.01f;
+
+    for (int y = std::max(y0, lamp_y - light_range); y <= std::min(y1, lamp_y + light_range); ++y)
+    {
+        for (int x = std::max(x0, lamp_x - light_range); x <= std::min(x1, lamp_x + light_range); ++x)
+        {
+            if ((x == lamp_x && y == lamp_y) || !isSolid(x, y))
+            {
+                continue;
+            }
+            for (int face = 0; face < 4; ++face)
+            {
+                FaceGeometry geometry = getFaceGeometry(x, y, (WallFace)face);
+                // faces between two walls can't be seen
+                if (isSolid(geometry.front.x, geometry.front.y))
+                {
+                    continue;
+                }
+
+                // light at both ends of the face, if the lamp can see them
+                sf::Vector2f start = geometry.start;
+                sf::Vector2f end = geometry.start + geometry.along;
+                float start_light = getLampLight(lamp, start);
+                float end_light = getLampLight(lamp, end);
+                if (start_light > 0.0f && !isLit(lamp, start + (geometry.along + geometry.normal) * margin))
+                {
+                    start_light = 0.0f;
+                }
+                if (end_light > 0.0f && !isLit(lamp, end + (geometry.normal - geometry.along) * margin))
+                {
+                    end_light = 0.0f;
+                }
+                if (start_light > 0.0f || end_light > 0.0f)
+                {
+                    // summed at both ends, saturated so many lamps together don't wrap to dark
+                    PackedLight &light = getLight(x, y, (WallFace)face);
+                    int start_sum = std::min(light.base + (int)lrint(start_light * light_one), (int)INT16_MAX);
+                    int end_sum = std::min(light.base + light.slope + (int)lrint(end_light * light_one), (int)INT16_MAX);
+                    light.base = start_sum;
+                    light.slope = end_sum - start_sum;
+                }
+            }
+        }
+    }
+}
+
+// give the page of a chunk back if none of its faces has light
+static void releaseDark(int chunk_x, int chunk_y)
+{
+    int &page = chunkPages[chunk_y * chunksX + chunk_x];
+    if (page < 0)
+    {
+        return;
+    }
+    const PackedLight *light = &pages[page].faces[0][0];
+    for (int i = 0; i < chunk_size * chunk_size * 4; ++i)
+    {
+        if (light[i].base != 0 || light[i].slope != 0)
+        {
+            return;
+        }
+    }
+    freePages.push_back(page);
+    page = -1;
+}
+
+// rebake all faces of the walls in x0, y0 - x1, y1
+static void bakeRegion(int x0, int y0, int x1, int y1)
+{
+    x0 = std::max(x0, 0);
+    y0 = std::max(y0, 0);
+    x1 = std::min(x1, getMapWidth() - 1);
+    y1 = std::min(y1, getMapHeight() - 1);
+
+    for (int y = y0; y <= y1; ++y)
+    {
+        for (int x = x0; x <= x1; ++x)
+        {
+            int page = chunkPages[(y >> chunk_shift) * chunksX + (x >> chunk_shift)];
+            for (int face = 0; face < 4; ++face)
+            {
+                if (page >= 0)
+                {
+                    pages[page].faces[(y & chunk_mask) * chunk_size + (x & chunk_mask)][face] = PackedLight{0, 0};
+                }
+                // lamps glow on their own
+                if (getTileAttributes(getTile(x, y)) & tile_emissive)
+                {
+                    getLight(x, y, (WallFace)face).base = light_one;
+                }
+            }
+        }
+    }
+
+    // every lamp in range of the region
+    for (int y = std::max(0, y0 - light_range); y <= std::min(getMapHeight() - 1, y1 + light_range); ++y)
+    {
+        for (int x = std::max(0, x0 - light_range); x <= std::min(getMapWidth() - 1, x1 + light_range); ++x)
+        {
+            if (getTileAttributes(getTile(x, y)) & tile_emissive)
+            {
+                bakeLamp(x, y, x0, y0, x1, y1);
+            }
+        }
+    }
+
+    // chunks that went dark, as the ones of a streamed map that are evicted, give their pages back
+    for (int chunk_y = y0 >> chunk_shift; chunk_y <= y1 >> chunk_shift; ++chunk_y)
+    {
+        for (int chunk_x = x0 >> chunk_shift; chunk_x <= x1 >> chunk_shift; ++chunk_x)
+        {
+            releaseDark(chunk_x, chunk_y);
+        }
+    }
+}
+
+// tiles set on the map rebake the faces around them. The rectangles of a change next to each other, as the
+// chunks of the map a chunk of the world fills, are baked as one, their regions would overlap.
+static void updateChanged(void *, const MapRect *rects, int count)
+{
+    const int reach = light_range + 1;
+    MapRect bounds = rects[0];
+    long separate = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        bounds.x0 = std::min(bounds.x0, rects[i].x0);
+        bounds.y0 = std::min(bounds.y0, rects[i].y0);
+        bounds.x1 = std::max(bounds.x1, rects[i].x1);
+        bounds.y1 = std::max(bounds.y1, rects[i].y1);
+        separate += (long)(rects[i].x1 - rects[i].x0 + 1 + 2 * reach) * (rects[i].y1 - rects[i].y0 + 1 + 2 * reach);
+    }
+    if ((long)(bounds.x1 - bounds.x0 + 1 + 2 * reach) * (bounds.y1 - bounds.y0 + 1 + 2 * reach) <= separate)
+    {
+        updateLightmapRect(bounds.x0, bounds.y0, bounds.x1, bounds.y1);
+        return;
+    }
+    for (int i = 0; i < count; ++i)
+    {
+        updateLightmapRect(rects[i].x0, rects[i].y0, rects[i].x1, rects[i].y1);
+    }
+}
+
+void bakeLightmap()
+{
+    clearLightmap();
+    bakeRegion(0, 0, getMapWidth() - 1, getMapHeight() - 1);
+}
+
+void clearLightmap()
+{
+    addMapListener(updateChanged, NULL);
+    chunksX = (getMapWidth() + chunk_mask) / chunk_size;
+    int chunksY = (getMapHeight() + chunk_mask) / chunk_size;
+    chunkPages.assign((size_t)chunksX * chunksY, -1);
+    pages.clear();
+    freePages.clear();
+}
+
+void updateLightmap(int x, int y)
+{
+    updateLightmapRect(x, y, x, y);
+}
+
+void updateLightmapRect(int x0, int y0, int x1, int y1)
+{
+    // the tiles can be lamps, walls in the way of one or in front of a face, so faces up to a step beyond
+    // light_range change
+    const int reach = light_range + 1;
+    bakeRegion(x0 - reach, y0 - reach, x1 + reach, y1 + reach);
+}
+
+int getLightPages()
+{
+    return pages.size();
+}
+
+FaceLight getFaceLight(int x, int y, WallFace face)
+{
+    if (x < 0 || y < 0 || x >= getMapWidth() || y >= getMapHeight())
+    {
+        return FaceLight{0.0f, 0.0f};
+    }
+    int page = chunkPages[(y >> chunk_shift) * chunksX + (x >> chunk_shift)];
+    if (page < 0)
+    {
+        return FaceLight{0.0f, 0.0f};
+    }
+    PackedLight light = pages[page].faces[(y & chunk_mask) * chunk_size + (x & chunk_mask)][(int)face];
+    return FaceLight{light.base / light_one, light.slope / light_one};
+}
@@ -0,0 +1,43 @@
+#ifndef Lightmap_hpp
+#define Lightmap_hpp
+#include <SFML/Graphics.hpp>
+#include "Map.h"
+
+// Light of lamp tiles on the faces of walls, baked when the map is loaded. Every face of a wall gets a
+// linear gradient along it, summed up over all lamps in range that can see the ends of the face. Tiles set
+// on the map later rebake only the faces in range of them.
+
+// distance in tiles a lamp lights up
+const int light_range = 2;
+
+// faces of a wall tile, by the side of the tile they are on
+enum class WallFace
+{
+    West,
+    East,
+    North,
+    South
+};
+
+// light on a face at wall_x, the position along the face between 0 and 1, is base + slope * wall_x
+struct FaceLight
+{
+    float base;
+    float slope;
+};
+
+// bake the light of all lamps of the loaded map
+void bakeLightmap();
+// size the lightmap for the loaded map, without any light. For maps that light their parts with
+// updateLightmapRect() as they come in.
+void clearLightmap();
+// rebake the faces that can be affected by a change of tile x, y
+void updateLightmap(int x, int y);
+// rebake the faces that can be affected by a change of the tiles in x0, y0 - x1, y1
+void updateLightmapRect(int x0, int y0, int x1, int y1);
+
+FaceLight getFaceLight(int x, int y, WallFace face);
+// pages of chunk light in memory, chunks that go dark give theirs back for others
+int getLightPages();
+
+#endif
@@ -1,35 +1,483 @@
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
 #include "Map.h"
 
-// get a tile from worldMap. Not memory safe.
-char getTile(int x, int y) {
-    return worldMap[y * mapWidth + x];
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// size of the map in tiles
+static int width = 0;
+static int height = 0;
+// number of chunks in a row and in a column of the map
+static int chunksX = 0;
+static int chunksY = 0;
+// tiles of all chunks, chunk by chunk, each chunk row by row
+static const char *tiles = NULL;
+// solidity bits of all chunks
+static const uint64_t *solidity = NULL;
+// source of the tiles of a streamed map, NULL for all other maps
+static TileProvider provider = NULL;
+
+// changed whenever tiles of the loaded map are
+static uint32_t version = 0;
+// changed whenever tiles of a chunk are, for every chunk of the map
+static std::vector<uint32_t> chunkVersions;
+
+// tiles set since the last published change, a rectangle per chunk, and the entry of every chunk in it
+static std::vector<MapRect> editRects;
+static std::vector<int> chunkEdits;
+// nesting of beginTileEdits()
+static int editDepth = 0;
+// the binary map file is mapped read only until the first tile is set
+static bool mappingWritable = false;
+
+struct Listener {
+    MapListener call;
+    void *user;
+};
+static std::vector<Listener> listeners;
+
+// storage of maps built in memory, from worldMap or a text file
+static std::vector<char> tileStorage;
+static std::vector<uint64_t> solidityStorage;
+// memory mapping of a binary map file
+static void *mapping = NULL;
+static size_t mappingSize = 0;
+
+static void unloadMap() {
+#ifndef _WIN32
+    if (mapping) {
+        munmap(mapping, mappingSize);
+    }
+#endif
+    mapping = NULL;
+    mappingSize = 0;
+    mappingWritable = false;
+    editRects.clear();
+    chunkEdits.clear();
+    tileStorage.clear();
+    solidityStorage.clear();
+    tiles = NULL;
+    solidity = NULL;
+    provider = NULL;
+    width = height = chunksX = chunksY = 0;
+    ++version;
 }
 
-// checks worldMap for errors
-// returns: true on success, false on errors found
-bool checkMap() {
-    // check size
+static void setSize(int w, int h) {
+    width = w;
+    height = h;
+    chunksX = (width + chunk_mask) / chunk_size;
+    chunksY = (height + chunk_mask) / chunk_size;
+    chunkVersions.assign((size_t)chunksX * chunksY, 0);
+    chunkEdits.assign((size_t)chunksX * chunksY, -1);
+}
+
+// build the chunked tiles and solidity grid from rows of tiles
+static void buildMap(const char *rows, int w, int h) {
+    unloadMap();
+    setSize(w, h);
+
+    // chunk tiles past the edge of the map are filled with walls
+    tileStorage.assign((size_t)chunksX * chunksY * chunk_size * chunk_size, outside_tile);
+    solidityStorage.assign((size_t)chunksX * chunksY, 0);
+    for (int y = 0; y < chunksY * chunk_size; ++y) {
+        for (int x = 0; x < chunksX * chunk_size; ++x) {
+            size_t chunk = (size_t)(y >> chunk_shift) * chunksX + (x >> chunk_shift);
+            int index = (y & chunk_mask) * chunk_size + (x & chunk_mask);
+            char tile = (x < width && y < height) ? rows[(size_t)y * width + x] : outside_tile;
+            tileStorage[chunk * chunk_size * chunk_size + index] = tile;
+            if (getTileAttributes(tile) & tile_solid) {
+                solidityStorage[chunk] |= uint64_t(1) << index;
+            }
+        }
+    }
+    tiles = tileStorage.data();
+    solidity = solidityStorage.data();
+}
+
+// build the map from the built-in worldMap
+// returns: true on success, false if worldMap doesn't match its size
+bool loadMap() {
     int mapSize = sizeof(worldMap) - 1; // - 1 because sizeof also counts the final NULL character
-    if (mapSize != mapWidth * mapHeight) {
-        fprintf(stderr, "Map size(%d) is not mapWidth * mapHeight(%d)\n", mapSize, mapWidth * mapHeight);
+    if (mapSize != worldMapWidth * worldMapHeight) {
+        fprintf(stderr, "Map size(%d) is not worldMapWidth * worldMapHeight(%d)\n", mapSize, worldMapWidth * worldMapHeight);
+        return false;
+    }
+    buildMap(worldMap, worldMapWidth, worldMapHeight);
+    return true;
+}
+
+void loadMapRows(const char *rows, int w, int h) {
+    buildMap(rows, w, h);
+}
+
+bool loadAsciiMap(const char *file) {
+    std::ifstream in(file);
+    if (!in) {
+        fprintf(stderr, "Cannot open map %s\n", file);
+        return false;
+    }
+
+    std::string rows;
+    std::string line;
+    int w = 0;
+    int h = 0;
+    while (std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.empty()) {
+            continue;
+        }
+        if (h > 0 && (int)line.size() != w) {
+            fprintf(stderr, "%s: row %d has %d tiles, expected %d\n", file, h, (int)line.size(), w);
+            return false;
+        }
+        w = line.size();
+        rows += line;
+        ++h;
+    }
+    if (h == 0) {
+        fprintf(stderr, "%s: map is empty\n", file);
+        return false;
+    }
+    buildMap(rows.data(), w, h);
+    return true;
+}
+
+// checks the header of a binary map against the size of its file
+static bool checkHeader(const MapFileHeader &header, size_t size, const char *file) {
+    if (memcmp(header.magic, "R3DM", 4) != 0 || header.version != map_file_version) {
+        fprintf(stderr, "%s: not a version %u map file\n", file, map_file_version);
+        return false;
+    }
+    uint64_t chunks = (uint64_t)header.chunks_x * header.chunks_y;
+    if (header.width == 0 || header.height == 0 || header.width > INT_MAX / 2 || header.height > INT_MAX / 2 ||
+        header.chunks_x != (header.width + chunk_mask) / chunk_size ||
+        header.chunks_y != (header.height + chunk_mask) / chunk_size) {
+        fprintf(stderr, "%s: bad map size %ux%u\n", file, header.width, header.height);
+        return false;
+    }
+    if (header.solidity_offset % sizeof(uint64_t) != 0 ||
+        header.tiles_offset > size || chunks * chunk_size * chunk_size > size - header.tiles_offset ||
+        header.solidity_offset > size || chunks * sizeof(uint64_t) > size - header.solidity_offset) {
+        fprintf(stderr, "%s: map layers don't fit in the file\n", file);
+        return false;
+    }
+    return true;
+}
+
+bool loadBinaryMap(const char *file) {
+    unloadMap();
+
+#ifndef _WIN32
+    int fd = open(file, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot open map %s\n", file);
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(MapFileHeader)) {
+        fprintf(stderr, "%s: not a map file\n", file);
+        close(fd);
+        return false;
+    }
+    // private read-only mapping, pages are only read from disk when the renderer touches them
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "Cannot map %s\n", file);
+        return false;
+    }
+    mapping = data;
+    mappingSize = st.st_size;
+    const char *bytes = (const char *)data;
+#else
+    // no mmap, read the whole file. Into 64 bit words, so the attribute layer stays aligned.
+    std::ifstream in(file, std::ios::binary);
+    std::vector<char> content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (!in.eof() || content.size() < sizeof(MapFileHeader)) {
+        fprintf(stderr, "Cannot read map %s\n", file);
+        return false;
+    }
+    mappingSize = content.size();
+    solidityStorage.resize((mappingSize + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+    memcpy(solidityStorage.data(), content.data(), mappingSize);
+    const char *bytes = (const char *)solidityStorage.data();
+#endif
+
+    MapFileHeader header;
+    memcpy(&header, bytes, sizeof(header));
+    if (!checkHeader(header, mappingSize, file)) {
+        unloadMap();
+        return false;
+    }
+    setSize(header.width, header.height);
+    tiles = bytes + header.tiles_offset;
+    solidity = (const uint64_t *)(bytes + header.solidity_offset);
+    return true;
+}
+
+bool saveBinaryMap(const char *file) {
+    if (provider) {
+        fprintf(stderr, "Streamed maps can't be written to %s\n", file);
+        return false;
+    }
+    FILE *out = fopen(file, "wb");
+    if (!out) {
+        fprintf(stderr, "Cannot write map %s\n", file);
         return false;
     }
 
-    for (int y = 0; y < mapHeight; ++y) {
-        for (int x = 0; x < mapWidth; ++x) {
+    size_t chunks = (size_t)chunksX * chunksY;
+    MapFileHeader header;
+    memcpy(header.magic, "R3DM", 4);
+    header.version = map_file_version;
+    header.width = width;
+    header.height = height;
+    header.chunks_x = chunksX;
+    header.chunks_y = chunksY;
+    header.tiles_offset = sizeof(MapFileHeader);
+    header.solidity_offset = header.tiles_offset + chunks * chunk_size * chunk_size;
+
+    bool ok = fwrite(&header, sizeof(header), 1, out) == 1 &&
+              fwrite(tiles, chunk_size * chunk_size, chunks, out) == chunks &&
+              fwrite(solidity, sizeof(uint64_t), chunks, out) == chunks;
+    if (fclose(out) != 0 || !ok) {
+        fprintf(stderr, "Cannot write map %s\n", file);
+        return false;
+    }
+    return true;
+}
+
+void loadStreamedMap(int w, int h, TileProvider source) {
+    unloadMap();
+    setSize(w, h);
+    solidityStorage.assign((size_t)chunksX * chunksY, ~uint64_t(0));
+    solidity = solidityStorage.data();
+    provider = source;
+}
+
+uint32_t getMapVersion() {
+    return version;
+}
+
+uint32_t getChunkVersion(int chunk_x, int chunk_y) {
+    if (chunk_x < 0 || chunk_y < 0 || chunk_x >= chunksX || chunk_y >= chunksY) {
+        return 0;
+    }
+    return chunkVersions[(size_t)chunk_y * chunksX + chunk_x];
+}
+
+void addMapListener(MapListener listener, void *user) {
+    for (const Listener &added : listeners) {
+        if (added.call == listener && added.user == user) {
+            return;
+        }
+    }
+    listeners.push_back(Listener{listener, user});
+}
+
+void removeMapListener(MapListener listener, void *user) {
+    for (size_t i = 0; i < listeners.size(); ++i) {
+        if (listeners[i].call == listener && listeners[i].user == user) {
+            listeners.erase(listeners.begin() + i);
+            return;
+        }
+    }
+}
+
+// where tile x, y inside of the map is stored, NULL for tiles of a streamed map that aren't in memory
+static char *getTileSlot(int x, int y) {
+    if (provider) {
+        return provider(x, y);
+    }
+#ifndef _WIN32
+    // the mapping is private, written pages become copies of the file
+    if (mapping && !mappingWritable) {
+        if (mprotect(mapping, mappingSize, PROT_READ | PROT_WRITE) != 0) {
+            return NULL;
+        }
+        mappingWritable = true;
+    }
+#endif
+    size_t chunk = (size_t)(y >> chunk_shift) * chunksX + (x >> chunk_shift);
+    return const_cast<char *>(&tiles[chunk * chunk_size * chunk_size + (y & chunk_mask) * chunk_size + (x & chunk_mask)]);
+}
+
+// hand the tiles set since the last call to the listeners
+static void publishEdits() {
+    if (editRects.empty()) {
+        return;
+    }
+    // one new version per published change, so listeners can tell if they missed one
+    ++version;
+    for (const Listener &listener : listeners) {
+        listener.call(listener.user, editRects.data(), editRects.size());
+    }
+    for (const MapRect &rect : editRects) {
+        chunkEdits[(size_t)(rect.y0 >> chunk_shift) * chunksX + (rect.x0 >> chunk_shift)] = -1;
+    }
+    editRects.clear();
+}
+
+// grow the rectangle of tiles changed in the chunk by rect, or start one, and publish it unless edits are
+// grouped
+static void addEdit(size_t chunk, const MapRect &rect) {
+    if (chunkEdits[chunk] < 0) {
+        chunkEdits[chunk] = editRects.size();
+        editRects.push_back(rect);
+    } else {
+        MapRect &grown = editRects[chunkEdits[chunk]];
+        grown.x0 = std::min(grown.x0, rect.x0);
+        grown.y0 = std::min(grown.y0, rect.y0);
+        grown.x1 = std::max(grown.x1, rect.x1);
+        grown.y1 = std::max(grown.y1, rect.y1);
+    }
+    if (editDepth == 0) {
+        publishEdits();
+    }
+}
+
+void setChunkSolidity(int chunk_x, int chunk_y, uint64_t bits, bool publish) {
+    size_t chunk = (size_t)chunk_y * chunksX + chunk_x;
+    solidityStorage[chunk] = bits;
+    ++chunkVersions[chunk];
+    if (!publish) {
+        ++version;
+        return;
+    }
+    int x0 = chunk_x << chunk_shift;
+    int y0 = chunk_y << chunk_shift;
+    addEdit(chunk, MapRect{x0, y0, std::min(x0 + chunk_mask, width - 1), std::min(y0 + chunk_mask, height - 1)});
+}
+
+bool setTile(int x, int y, char tile) {
+    if (x < 0 || y < 0 || x >= width || y >= height || !(getTileAttributes(tile) & tile_valid)) {
+        return false;
+    }
+    char *slot = getTileSlot(x, y);
+    if (!slot) {
+        return false;
+    }
+    if (*slot == tile) {
+        return true;
+    }
+    *slot = tile;
+
+    size_t chunk = (size_t)(y >> chunk_shift) * chunksX + (x >> chunk_shift);
+    uint64_t bit = uint64_t(1) << ((y & chunk_mask) * chunk_size + (x & chunk_mask));
+    uint64_t &bits = const_cast<uint64_t &>(solidity[chunk]);
+    bits = (getTileAttributes(tile) & tile_solid) ? bits | bit : bits & ~bit;
+    ++chunkVersions[chunk];
+    addEdit(chunk, MapRect{x, y, x, y});
+    return true;
+}
+
+void beginTileEdits() {
+    ++editDepth;
+}
+
+void endTileEdits() {
+    if (editDepth > 0 && --editDepth == 0) {
+        publishEdits();
+    }
+}
+
+int getMapWidth() {
+    return width;
+}
+
+int getMapHeight() {
+    return height;
+}
+
+int getMapChunksX() {
+    return chunksX;
+}
+
+const uint64_t *getSolidity() {
+    return solidity;
+}
+
+uint64_t getChunkSolidity(int chunk_x, int chunk_y) {
+    if (chunk_x < 0 || chunk_y < 0 || chunk_x >= chunksX || chunk_y >= chunksY) {
+        return ~uint64_t(0);
+    }
+    return solidity[(size_t)chunk_y * chunksX + chunk_x];
+}
+
+// get a tile from the chunked map, outside_tile for coordinates outside of the map
+char getTile(int x, int y) {
+    if (x < 0 || y < 0 || x >= width || y >= height) {
+        return outside_tile;
+    }
+    if (provider) {
+        const char *tile = provider(x, y);
+        return tile ? *tile : outside_tile;
+    }
+    size_t chunk = (size_t)(y >> chunk_shift) * chunksX + (x >> chunk_shift);
+    return tiles[chunk * chunk_size * chunk_size + (y & chunk_mask) * chunk_size + (x & chunk_mask)];
+}
+
+// is the tile a wall? Everything outside of the map is.
+bool isSolid(int x, int y) {
+    return (getChunkSolidity(x >> chunk_shift, y >> chunk_shift) >>
+            ((y & chunk_mask) * chunk_size + (x & chunk_mask))) & 1;
+}
+
+sf::Vector2i findFloor(sf::Vector2i tile) {
+    int radius_limit = std::max(width, height);
+    for (int radius = 0; radius < radius_limit; ++radius) {
+        // walk the border of the square, top and bottom rows, then left and right columns
+        for (int x = tile.x - radius; x <= tile.x + radius; ++x) {
+            if (!isSolid(x, tile.y - radius))
+                return sf::Vector2i(x, tile.y - radius);
+            if (!isSolid(x, tile.y + radius))
+                return sf::Vector2i(x, tile.y + radius);
+        }
+        for (int y = tile.y - radius + 1; y < tile.y + radius; ++y) {
+            if (!isSolid(tile.x - radius, y))
+                return sf::Vector2i(tile.x - radius, y);
+            if (!isSolid(tile.x + radius, y))
+                return sf::Vector2i(tile.x + radius, y);
+        }
+    }
+    return tile;
+}
+
+// checks the loaded map for errors
+// returns: true on success, false on errors found
+bool checkMap() {
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
             char tile = getTile(x, y);
             // check if tile type is valid
-            if (tile != '.' && wallTypes.find(tile) == wallTypes.end()) {
+            if (!(getTileAttributes(tile) & tile_valid)) {
                 fprintf(stderr, "map tile at [%3d,%3d] has an unknown tile type(%c)\n", x, y, tile);
                 return false;
             }
             // check if edges are walls
-            if ((y == 0 || x == 0 || y == mapHeight - 1 || x == mapWidth - 1) &&
-                tile == '.') {
+            if ((y == 0 || x == 0 || y == height - 1 || x == width - 1) &&
+                !(getTileAttributes(tile) & tile_solid)) {
                 fprintf(stderr, "map edge at [%3d,%3d] is a floor (should be wall)\n", x, y);
                 return false;
             }
+            // check if the attribute layer matches the tiles
+            if (isSolid(x, y) != bool(getTileAttributes(tile) & tile_solid)) {
+                fprintf(stderr, "map tile at [%3d,%3d] has wrong solidity\n", x, y);
+                return false;
+            }
         }
     }
     return true;
-}
\ No newline at end of file
+}
@@ -1,11 +1,13 @@
 #ifndef Map_hpp
 #define Map_hpp
 
-#include <unordered_map>
+#include <limits.h>
+#include <stdint.h>
+#include <SFML/Graphics.hpp>
 
-// size of the top-down world map in tiles
-const int mapWidth = 32;
-const int mapHeight = 32;
+// size of the built-in world map in tiles
+const int worldMapWidth = 32;
+const int worldMapHeight = 32;
 
 // minimap scale
 const int map_scale = 8;
@@ -87,16 +89,164 @@ enum class WallTexture
         Lamp
 };
 
-// valid wall types and their texture for the world map
-const std::unordered_map<char, WallTexture> wallTypes{
-    {'1', WallTexture::Wall},
-    {'2', WallTexture::Bush},
-    {'3', WallTexture::Door},
-    {'4', WallTexture::BigWall},
-    {'5', WallTexture::Lamp},
+// attributes of a tile type, bits of a tileAttributes entry
+const uint8_t tile_valid = 1 << 0;   // tile type exists
+const uint8_t tile_solid = 1 << 1;   // blocks rays and movement
+const uint8_t tile_emissive = 1 << 2; // lights up walls around it
+const uint8_t tile_door = 1 << 3;     // opens when the player comes close, see Doors.h
+// the wall texture is stored in the upper bits
+const int tile_texture_shift = 4;
+
+constexpr uint8_t wallAttributes(WallTexture texture, uint8_t flags = 0)
+{
+    return tile_valid | tile_solid | flags | (uint8_t)((int)texture << tile_texture_shift);
+}
+
+// attributes of every possible tile character, zero for unknown tile types
+struct TileAttributeTable
+{
+    uint8_t attributes[256];
+};
+
+constexpr TileAttributeTable makeTileAttributes()
+{
+    TileAttributeTable table{};
+    table.attributes['.'] = tile_valid;
+    // valid wall types and their texture for the world map
+    table.attributes['1'] = wallAttributes(WallTexture::Wall);
+    table.attributes['2'] = wallAttributes(WallTexture::Bush);
+    table.attributes['3'] = wallAttributes(WallTexture::Door, tile_door);
+    table.attributes['4'] = wallAttributes(WallTexture::BigWall);
+    table.attributes['5'] = wallAttributes(WallTexture::Lamp, tile_emissive);
+    // door that is open, walked through like floor
+    table.attributes['_'] = tile_valid | tile_door;
+    return table;
+}
+
+constexpr TileAttributeTable tileAttributes = makeTileAttributes();
+
+constexpr uint8_t getTileAttributes(char tile)
+{
+    return tileAttributes.attributes[(unsigned char)tile];
+}
+
+constexpr WallTexture getWallTexture(char tile)
+{
+    return (WallTexture)(getTileAttributes(tile) >> tile_texture_shift);
+}
+
+// The map is stored in square chunks of chunk_size tiles. The tiles of a chunk fill one 64 byte
+// cache line, the solidity of a chunk is one 64 bit word, bit (y % chunk_size) * chunk_size + x % chunk_size.
+const int chunk_shift = 3;
+const int chunk_size = 1 << chunk_shift;
+const int chunk_mask = chunk_size - 1;
+// tile returned for coordinates outside of the map
+const char outside_tile = '1';
+
+// binary map file: header, tile layer, attribute layer. Both layers are stored chunk by chunk, the
+// tile layer has chunk_size * chunk_size tiles per chunk, row by row, the attribute layer has the 64 bit
+// solidity word of every chunk. Offsets are from the start of the file, the attribute layer is 8 byte
+// aligned so it can be used straight from a memory mapping.
+struct MapFileHeader
+{
+    char magic[4];    // "R3DM"
+    uint32_t version; // map_file_version
+    uint32_t width;   // in tiles
+    uint32_t height;
+    uint32_t chunks_x; // in chunks
+    uint32_t chunks_y;
+    uint64_t tiles_offset;
+    uint64_t solidity_offset;
+};
+const uint32_t map_file_version = 1;
+
+// size of the loaded map in tiles
+int getMapWidth();
+int getMapHeight();
+// number of chunks in a row of the map
+int getMapChunksX();
+// solidity bits of every chunk, row by row. Chunk tiles outside of the map are solid.
+const uint64_t *getSolidity();
+uint64_t getChunkSolidity(int chunk_x, int chunk_y);
+
+// walks the solidity grid tile by tile. Bounds are only checked when it enters another chunk,
+// everything outside of the map is solid.
+class SolidityCursor
+{
+public:
+    bool isSolid(int x, int y)
+    {
+        if ((x >> chunk_shift) != chunk_x || (y >> chunk_shift) != chunk_y)
+        {
+            chunk_x = x >> chunk_shift;
+            chunk_y = y >> chunk_shift;
+            bits = getChunkSolidity(chunk_x, chunk_y);
+        }
+        return (bits >> ((y & chunk_mask) * chunk_size + (x & chunk_mask))) & 1;
+    }
+    // is the chunk of the last tile asked for empty?
+    bool isChunkEmpty() const
+    {
+        return bits == 0;
+    }
+
+private:
+    int chunk_x = INT_MIN;
+    int chunk_y = INT_MIN;
+    uint64_t bits = 0;
+};
+
+// tile x, y of a streamed map, inside of the map. NULL where the tile isn't in memory, it's solid rock.
+typedef char *(*TileProvider)(int x, int y);
+
+// build the chunked tiles and solidity grid from the built-in worldMap
+bool loadMap();
+// build the map from width * height tiles in memory, row by row, same characters as worldMap
+void loadMapRows(const char *rows, int width, int height);
+// build the map from a text file, one row of tiles per line, same characters as worldMap
+bool loadAsciiMap(const char *file);
+// memory map a binary map file, tiles are read from the file without copying them
+bool loadBinaryMap(const char *file);
+// write the loaded map as binary map file
+bool saveBinaryMap(const char *file);
+// start a map of width * height tiles that aren't stored in it. Tiles are read from the provider, the
+// solidity grid starts out solid and is filled in with setChunkSolidity() as tiles become available.
+void loadStreamedMap(int width, int height, TileProvider provider);
+// replace the solidity bits of a chunk of a streamed map, whose tiles changed with them
+// publish: hand the whole chunk to the listeners as setTile() does, otherwise they have to be rebuilt
+void setChunkSolidity(int chunk_x, int chunk_y, uint64_t bits, bool publish);
+// changes whenever tiles of the map do: a new map, chunks of a streamed one, or tiles set, by one for
+// every published change
+uint32_t getMapVersion();
+// changes whenever tiles of the chunk do, 0 outside of the map
+uint32_t getChunkVersion(int chunk_x, int chunk_y);
+
+// tiles x0, y0 - x1, y1 of the map, inclusive
+struct MapRect
+{
+    int x0, y0, x1, y1;
 };
+// Tiles can be changed while the map is loaded. Every change is published to the listeners as rectangles
+// of the tiles that changed, one per chunk at most, so what is derived from the map only redoes those.
+// Listeners are called on the thread that changes the tiles, right after the change.
+typedef void (*MapListener)(void *user, const MapRect *rects, int count);
+// a listener that was added already with the same user isn't added again, so what is rebuilt for every
+// map can add its listener every time
+void addMapListener(MapListener listener, void *user);
+void removeMapListener(MapListener listener, void *user);
+// set tile x, y and its solidity. Binary maps are copied page by page as they are written to, the file
+// stays the same. Streamed maps lose their changes when the chunk is evicted.
+// returns: false outside of the map, for unknown tile types and tiles of a streamed map not in memory
+bool setTile(int x, int y, char tile);
+// tiles set between begin and end are published together, when the outermost end is reached
+void beginTileEdits();
+void endTileEdits();
+// floor tile closest to the given one, searched in growing squares around it
+sf::Vector2i findFloor(sf::Vector2i tile);
 
+// get a tile, outside_tile for coordinates outside of the map
 char getTile(int, int);
+bool isSolid(int, int);
 
 bool checkMap();
 
@@ -0,0 +1,127 @@
+#include "Minimap.h"
+#include <algorithm>
+#include "Engine.h"
+
+// colors of the tiles
+const sf::Color minimap_wall = sf::Color::Black;
+const sf::Color minimap_floor(255, 255, 255, 125);
+// size of the player marker in pixels
+const float minimap_player = map_scale - 3;
+
+Minimap::Minimap()
+    : tiles(minimap_tiles * minimap_tiles * 4),
+      // no tile is written yet, slots hold a tile that is never in view
+      slotTiles(minimap_tiles * minimap_tiles, sf::Vector2i(INT_MIN, INT_MIN)),
+      origin(INT_MIN, INT_MIN)
+{
+    addMapListener(markChanged, this);
+}
+
+Minimap::~Minimap()
+{
+    removeMapListener(markChanged, this);
+}
+
+void Minimap::markChanged(void *minimap, const MapRect *rects, int count)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        for (int y = rects[i].y0; y <= rects[i].y1; ++y)
+        {
+            for (int x = rects[i].x0; x <= rects[i].x1; ++x)
+            {
+                static_cast<Minimap *>(minimap)->markDirty(x, y);
+            }
+        }
+    }
+}
+
+static int getSlot(int x, int y)
+{
+    // modulo that stays positive for tiles left of or above the map
+    int slot_x = (x % minimap_tiles + minimap_tiles) % minimap_tiles;
+    int slot_y = (y % minimap_tiles + minimap_tiles) % minimap_tiles;
+    return slot_y * minimap_tiles + slot_x;
+}
+
+void Minimap::writeTile(int x, int y)
+{
+    int slot = getSlot(x, y);
+    slotTiles[slot] = sf::Vector2i(x, y);
+
+    sf::Color color = isSolid(x, y) ? minimap_wall : minimap_floor;
+    // tiles outside of the map are left out
+    if (x < 0 || y < 0 || x >= getMapWidth() || y >= getMapHeight())
+    {
+        color = sf::Color::Transparent;
+    }
+    sf::Vertex *quad = &tiles[slot * 4];
+    float left = x * map_scale;
+    float top = y * map_scale;
+    quad[0] = sf::Vertex(sf::Vector2f(left, top), color);
+    quad[1] = sf::Vertex(sf::Vector2f(left + map_scale, top), color);
+    quad[2] = sf::Vertex(sf::Vector2f(left + map_scale, top + map_scale), color);
+    quad[3] = sf::Vertex(sf::Vector2f(left, top + map_scale), color);
+}
+
+void Minimap::markDirty(int x, int y)
+{
+    // tiles out of view are written when they scroll in
+    if (slotTiles[getSlot(x, y)] == sf::Vector2i(x, y))
+    {
+        writeTile(x, y);
+    }
+}
+
+void Minimap::scroll(sf::Vector2i view)
+{
+    if (view == origin)
+    {
+        return;
+    }
+    origin = view;
+    for (int y = origin.y; y < origin.y + minimap_tiles; ++y)
+    {
+        for (int x = origin.x; x < origin.x + minimap_tiles; ++x)
+        {
+            if (slotTiles[getSlot(x, y)] != sf::Vector2i(x, y))
+            {
+                writeTile(x, y);
+            }
+        }
+    }
+}
+
+void Minimap::draw(sf::RenderWindow &window, const std::vector<sf::Vertex> &rays, sf::Vector2f player)
+{
+    // center the view on the player, but keep it inside of the map where the map is big enough
+    sf::Vector2i view(int(player.x) - minimap_tiles / 2, int(player.y) - minimap_tiles / 2);
+    view.x = std::max(0, std::min(view.x, getMapWidth() - minimap_tiles));
+    view.y = std::max(0, std::min(view.y, getMapHeight() - minimap_tiles));
+    scroll(view);
+
+    // everything outside of the minimap is cut off by the viewport
+    const float size = minimap_tiles * map_scale;
+    const float width = getScreenWidth();
+    const float height = getScreenHeight();
+    sf::View minimap(sf::FloatRect(0, 0, size, size));
+    minimap.setViewport(sf::FloatRect(minimap_left / width, minimap_top / height, size / width, size / height));
+    window.setView(minimap);
+
+    sf::RenderStates state;
+    state.transform.translate(-origin.x * map_scale, -origin.y * map_scale);
+    window.draw(tiles.data(), tiles.size(), sf::Quads, state);
+    window.draw(rays.data(), rays.size(), sf::Lines, state);
+
+    // draw player
+    sf::Vector2f center = player * (float)map_scale;
+    float half = minimap_player / 2;
+    sf::Vertex marker[4] = {
+        sf::Vertex(center + sf::Vector2f(-half, -half), sf::Color::Magenta),
+        sf::Vertex(center + sf::Vector2f(half, -half), sf::Color::Magenta),
+        sf::Vertex(center + sf::Vector2f(half, half), sf::Color::Magenta),
+        sf::Vertex(center + sf::Vector2f(-half, half), sf::Color::Magenta)};
+    window.draw(marker, 4, sf::Quads, state);
+
+    window.setView(window.getDefaultView());
+}
@@ -0,0 +1,47 @@
+#ifndef Minimap_hpp
+#define Minimap_hpp
+#include <SFML/Graphics.hpp>
+#include <vector>
+#include "Map.h"
+
+// tiles shown along each side of the minimap, the built-in map fits completely
+const int minimap_tiles = 32;
+// position of the minimap on the screen
+const float minimap_left = 10;
+const float minimap_top = 10;
+
+// Minimap drawn as one batch of tile quads. The batch covers the minimap_tiles x minimap_tiles view
+// around the player, every tile of the map has a fixed slot in it (its coordinates modulo the view
+// size). When the view moves only the tiles that scrolled in are written, tiles changed on the map are
+// rewritten after markDirty(), tiles set on the map are marked as they are. Positions are map coordinates
+// times map_scale.
+class Minimap
+{
+public:
+    Minimap();
+    ~Minimap();
+    // it's listening to the map with its address
+    Minimap(const Minimap &) = delete;
+    Minimap &operator=(const Minimap &) = delete;
+
+    // the tile changed its solidity
+    void markDirty(int x, int y);
+    // draw tiles around the player, the rays of the frame (pairs of vertices in the same coordinates as
+    // the tiles) and the player on top
+    void draw(sf::RenderWindow &window, const std::vector<sf::Vertex> &rays, sf::Vector2f player);
+
+private:
+    static void markChanged(void *minimap, const MapRect *rects, int count);
+    // move the view to origin, rewrite the slots of tiles that aren't in the batch yet
+    void scroll(sf::Vector2i origin);
+    void writeTile(int x, int y);
+
+    // four vertices per slot
+    std::vector<sf::Vertex> tiles;
+    // tile written to each slot, so scrolling knows which ones are still right
+    std::vector<sf::Vector2i> slotTiles;
+    // upper left tile of the view
+    sf::Vector2i origin;
+};
+
+#endif
@@ -0,0 +1,216 @@
+#include "Movement.h"
+#include <algorithm>
+#include "Map.h"
+#include "Raycast.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MOVEMENT_X86
+#include <immintrin.h>
+#endif
+
+// bodies swept together. Their boxes are converted to tile bounds in loops over the whole block,
+// which the compiler vectorizes, before the tiles are tested one body at a time.
+const int body_block = 64;
+
+// tiles covered by the boxes of a block
+struct BlockBounds
+{
+    int left[body_block];
+    int top[body_block];
+    int right[body_block];
+    int bottom[body_block];
+};
+
+static void getBounds(const float *x, const float *y, const float *size, int count, BlockBounds &bounds)
+{
+    // converted towards zero, as sf::Vector2i does
+    for (int i = 0; i < count; ++i)
+    {
+        float half = size[i] / 2.0f;
+        bounds.left[i] = (int)(x[i] - half);
+        bounds.right[i] = (int)(x[i] + half);
+    }
+    for (int i = 0; i < count; ++i)
+    {
+        float half = size[i] / 2.0f;
+        bounds.top[i] = (int)(y[i] - half);
+        bounds.bottom[i] = (int)(y[i] + half);
+    }
+}
+
+// are the tiles left - right, top - bottom inside of the map and empty?
+static bool isFree(int left, int top, int right, int bottom)
+{
+    if (left < 0 || top < 0 || right >= getMapWidth() || bottom >= getMapHeight())
+    {
+        return false;
+    }
+    // the box can cover more than one tile, and more than one chunk
+    SolidityCursor cursor;
+    for (int y = top; y <= bottom; ++y)
+    {
+        for (int x = left; x <= right; ++x)
+        {
+            if (cursor.isSolid(x, y))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// which bodies first - end of a block fit in their bounds. Boxes smaller than a tile cover at most
+// 2 * 2 tiles, the ones at their corners, so they're tested without branches. Larger ones loop over their tiles.
+static void testBodies(const BlockBounds &bounds, const float *size, int first, int end, uint8_t *free)
+{
+    const uint64_t *solidity = getSolidity();
+    const int chunks_x = getMapChunksX();
+    const int width = getMapWidth();
+    const int height = getMapHeight();
+    auto solid = [&](int x, int y) {
+        return (solidity[(size_t)(y >> chunk_shift) * chunks_x + (x >> chunk_shift)] >>
+                ((y & chunk_mask) * chunk_size + (x & chunk_mask))) & 1;
+    };
+
+    for (int i = first; i < end; ++i)
+    {
+        if (size[i] >= 1.0f)
+        {
+            free[i] = isFree(bounds.left[i], bounds.top[i], bounds.right[i], bounds.bottom[i]);
+            continue;
+        }
+        int left = bounds.left[i];
+        int top = bounds.top[i];
+        int right = bounds.right[i];
+        int bottom = bounds.bottom[i];
+        bool inside = (left >= 0) & (top >= 0) & (right < width) & (bottom < height);
+        // clamped so boxes outside of the map don't read outside of it, they aren't free anyway
+        left = std::min(std::max(left, 0), width - 1);
+        top = std::min(std::max(top, 0), height - 1);
+        right = std::min(std::max(right, 0), width - 1);
+        bottom = std::min(std::max(bottom, 0), height - 1);
+        uint64_t blocked = solid(left, top) | solid(right, top) | solid(left, bottom) | solid(right, bottom);
+        free[i] = inside & !blocked;
+    }
+}
+
+#ifdef MOVEMENT_X86
+// bit 0 is set for solid tiles x, y, and for lanes that aren't inside. Every chunk is two 32 bit words.
+__attribute__((target("avx2")))
+static inline __m256i gatherSolid(const int *solidity, __m256i chunks_x, __m256i x, __m256i y, __m256i inside)
+{
+    const __m256i mask = _mm256_set1_epi32(chunk_mask);
+    const __m256i chunk = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_srai_epi32(y, chunk_shift), chunks_x),
+                                           _mm256_srai_epi32(x, chunk_shift));
+    const __m256i bit = _mm256_add_epi32(_mm256_slli_epi32(_mm256_and_si256(y, mask), chunk_shift), _mm256_and_si256(x, mask));
+    const __m256i word = _mm256_add_epi32(_mm256_slli_epi32(chunk, 1), _mm256_srli_epi32(bit, 5));
+    const __m256i words = _mm256_mask_i32gather_epi32(_mm256_set1_epi32(-1), solidity, word, inside, 4);
+    return _mm256_srlv_epi32(words, _mm256_and_si256(bit, _mm256_set1_epi32(31)));
+}
+
+// the small boxes of 8 bodies at a time, the corners are gathered like in castRaysAVX2()
+__attribute__((target("avx2")))
+static int testBodiesAVX2(const BlockBounds &bounds, const float *size, int count, uint8_t *free)
+{
+    const int *solidity = (const int *)getSolidity();
+    const __m256i chunks_x = _mm256_set1_epi32(getMapChunksX());
+    const __m256i width = _mm256_set1_epi32(getMapWidth());
+    const __m256i height = _mm256_set1_epi32(getMapHeight());
+    const __m256i minus_one = _mm256_set1_epi32(-1);
+
+    int first = 0;
+    for (; first + 8 <= count; first += 8)
+    {
+        const __m256i left = _mm256_loadu_si256((const __m256i *)(bounds.left + first));
+        const __m256i top = _mm256_loadu_si256((const __m256i *)(bounds.top + first));
+        const __m256i right = _mm256_loadu_si256((const __m256i *)(bounds.right + first));
+        const __m256i bottom = _mm256_loadu_si256((const __m256i *)(bounds.bottom + first));
+        // boxes leaving the map skip the gathers and aren't free
+        const __m256i inside = _mm256_and_si256(
+            _mm256_and_si256(_mm256_cmpgt_epi32(left, minus_one), _mm256_cmpgt_epi32(top, minus_one)),
+            _mm256_and_si256(_mm256_cmpgt_epi32(width, right), _mm256_cmpgt_epi32(height, bottom)));
+        const __m256i blocked = _mm256_or_si256(
+            _mm256_or_si256(gatherSolid(solidity, chunks_x, left, top, inside), gatherSolid(solidity, chunks_x, right, top, inside)),
+            _mm256_or_si256(gatherSolid(solidity, chunks_x, left, bottom, inside), gatherSolid(solidity, chunks_x, right, bottom, inside)));
+        const __m256i open = _mm256_andnot_si256(blocked, _mm256_set1_epi32(1));
+        const int fits = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(open, _mm256_set1_epi32(1))));
+        const int large = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(size + first), _mm256_set1_ps(1.0f), _CMP_GE_OQ));
+        for (int i = 0; i < 8; ++i)
+        {
+            free[first + i] = (fits >> i) & 1;
+        }
+        // the few large boxes loop over all of their tiles
+        for (int lanes = large; lanes; lanes &= lanes - 1)
+        {
+            int i = first + __builtin_ctz(lanes);
+            free[i] = isFree(bounds.left[i], bounds.top[i], bounds.right[i], bounds.bottom[i]);
+        }
+    }
+    return first;
+}
+#endif
+
+// which bodies of a block fit in their bounds
+static void testBlock(const BlockBounds &bounds, const float *size, int count, uint8_t *free)
+{
+    int first = 0;
+#ifdef MOVEMENT_X86
+    // the raycaster's choice, so --scalar turns this off as well
+    if (getRaycastSimd() == RaycastSimd::AVX2)
+    {
+        first = testBodiesAVX2(bounds, size, count, free);
+    }
+#endif
+    testBodies(bounds, size, first, count, free);
+}
+
+void moveBodies(const BodyBatch &batch)
+{
+    float moved_x[body_block];
+    float moved_y[body_block];
+    uint8_t free[body_block];
+    BlockBounds bounds;
+
+    for (int first = 0; first < batch.count; first += body_block)
+    {
+        int count = std::min(body_block, batch.count - first);
+        const float *x = batch.x + first;
+        const float *y = batch.y + first;
+        const float *size = batch.size + first;
+        float *out_x = batch.out_x + first;
+        float *out_y = batch.out_y + first;
+
+        // both candidates before anything is written, the outputs can be the inputs
+        for (int i = 0; i < count; ++i)
+        {
+            moved_x[i] = x[i] + batch.velocity_x[first + i];
+            moved_y[i] = y[i] + batch.velocity_y[first + i];
+        }
+
+        // along x, at the old y
+        getBounds(moved_x, y, size, count, bounds);
+        testBlock(bounds, size, count, free);
+        for (int i = 0; i < count; ++i)
+        {
+            moved_x[i] = free[i] ? moved_x[i] : x[i];
+        }
+
+        // along y, at the resolved x
+        getBounds(moved_x, moved_y, size, count, bounds);
+        testBlock(bounds, size, count, free);
+        for (int i = 0; i < count; ++i)
+        {
+            out_y[i] = free[i] ? moved_y[i] : y[i];
+            out_x[i] = moved_x[i];
+        }
+    }
+}
+
+bool isBoxFree(sf::Vector2f position, float size)
+{
+    sf::Vector2f half(size / 2.0f, size / 2.0f);
+    sf::Vector2i upper_left(position - half);
+    sf::Vector2i lower_right(position + half);
+    return isFree(upper_left.x, upper_left.y, lower_right.x, lower_right.y);
+}
@@ -0,0 +1,30 @@
+#ifndef Movement_hpp
+#define Movement_hpp
+#include <SFML/Graphics.hpp>
+
+// bodies moved together by moveBodies(), every array has count entries
+struct BodyBatch
+{
+    // middle of the square collision box of every body, in map coordinates
+    const float *x;
+    const float *y;
+    // movement of this step, in tiles
+    const float *velocity_x;
+    const float *velocity_y;
+    // side of the collision box, in tiles
+    const float *size;
+    // resolved positions, can be the same arrays as x and y
+    float *out_x;
+    float *out_y;
+    int count;
+};
+
+// move every body first along x and then along y. A body only moves along an axis if its box doesn't
+// overlap a solid tile or leave the map there, so it slides along walls. For a single body it's the
+// same as checking both axes with canMove().
+void moveBodies(const BodyBatch &batch);
+
+// does a square box of size with its middle at position fit between the walls, inside of the map?
+bool isBoxFree(sf::Vector2f position, float size);
+
+#endif
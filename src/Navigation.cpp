@@ -0,0 +1,220 @@
+#include "Navigation.h"
+#include <math.h>
+#include <algorithm>
+#include <vector>
+#include "Engine.h"
+#include "Entities.h"
+#include "Map.h"
+#include "Movement.h"
+#include "ThreadPool.h"
+
+// distances of the tiles of a square of the map, row by row
+struct DistanceField
+{
+    sf::Vector2i origin; // upper left tile
+    sf::Vector2i target; // tile of the player it leads to
+    bool valid = false;
+    std::vector<uint16_t> distance;
+    // tiles in breadth first order, the queue of the search
+    std::vector<int> queue;
+};
+
+// agents follow fields[front], fields[1 - front] is rebuilt
+static DistanceField fields[2];
+static int front = 0;
+// tiles the field covers were set on the map since it was built
+static bool fieldChanged = false;
+
+// entity of every agent
+static std::vector<int> agents;
+// bodies of the agents during a tick, moved as batches by moveBodies()
+static std::vector<float> bodyX;
+static std::vector<float> bodyY;
+static std::vector<float> velocityX;
+static std::vector<float> velocityY;
+static std::vector<float> bodySize;
+
+static const sf::Vector2i neighbours[4] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+
+static uint16_t getDistance(const DistanceField &field, int x, int y)
+{
+    int field_x = x - field.origin.x;
+    int field_y = y - field.origin.y;
+    if (!field.valid || field_x < 0 || field_y < 0 || field_x >= nav_size || field_y >= nav_size)
+    {
+        return nav_unreachable;
+    }
+    return field.distance[field_y * nav_size + field_x];
+}
+
+// breadth first search from target over the floor tiles in reach
+static void buildField(DistanceField &field, sf::Vector2i target)
+{
+    field.origin = target - sf::Vector2i(nav_radius, nav_radius);
+    field.target = target;
+    field.valid = true;
+    field.distance.assign(nav_size * nav_size, nav_unreachable);
+    field.queue.resize(nav_size * nav_size);
+    if (isSolid(target.x, target.y))
+    {
+        return;
+    }
+
+    int head = 0;
+    int tail = 0;
+    int start = nav_radius * nav_size + nav_radius;
+    field.distance[start] = 0;
+    field.queue[tail++] = start;
+    SolidityCursor cursor;
+    while (head < tail)
+    {
+        int tile = field.queue[head++];
+        int x = tile % nav_size;
+        int y = tile / nav_size;
+        uint16_t next = field.distance[tile] + 1;
+        for (sf::Vector2i step : neighbours)
+        {
+            int nx = x + step.x;
+            int ny = y + step.y;
+            if (nx < 0 || ny < 0 || nx >= nav_size || ny >= nav_size)
+            {
+                continue;
+            }
+            int neighbour = ny * nav_size + nx;
+            if (field.distance[neighbour] == nav_unreachable &&
+                !cursor.isSolid(field.origin.x + nx, field.origin.y + ny))
+            {
+                field.distance[neighbour] = next;
+                field.queue[tail++] = neighbour;
+            }
+        }
+    }
+}
+
+// movement of an agent in dt seconds towards the player along field
+static sf::Vector2f steer(const DistanceField &field, sf::Vector2f position, float dt)
+{
+    sf::Vector2i tile((int)floorf(position.x), (int)floorf(position.y));
+    uint16_t distance = getDistance(field, tile.x, tile.y);
+    if (distance == 0 || distance == nav_unreachable)
+    {
+        return sf::Vector2f(0.0f, 0.0f);
+    }
+
+    // middle of the neighbour tile closest to the player. The line to it only crosses the tile of the
+    // agent and that one, so agents never cut through walls.
+    sf::Vector2i best = tile;
+    for (sf::Vector2i step : neighbours)
+    {
+        uint16_t next = getDistance(field, tile.x + step.x, tile.y + step.y);
+        if (next < distance)
+        {
+            distance = next;
+            best = tile + step;
+        }
+    }
+    sf::Vector2f offset = sf::Vector2f(best.x + 0.5f, best.y + 0.5f) - position;
+    float length = sqrtf(offset.x * offset.x + offset.y * offset.y);
+    float step = agent_speed * dt;
+    return length <= step ? offset : offset * (step / length);
+}
+
+// the field is searched again when tiles it covers change, changes elsewhere don't matter to it
+static void checkChanged(void *, const MapRect *rects, int count)
+{
+    const DistanceField &field = fields[front];
+    for (int i = 0; i < count; ++i)
+    {
+        const MapRect &rect = rects[i];
+        if (rect.x1 >= field.origin.x && rect.y1 >= field.origin.y && rect.x0 < field.origin.x + nav_size &&
+            rect.y0 < field.origin.y + nav_size)
+        {
+            fieldChanged = true;
+        }
+    }
+}
+
+void clearAgents()
+{
+    addMapListener(checkChanged, NULL);
+    agents.clear();
+    fields[0].valid = false;
+    fields[1].valid = false;
+}
+
+void scatterAgents(int count, unsigned seed)
+{
+    int first = getEntityCount();
+    scatterEntities(count, seed);
+    for (int id = first; id < getEntityCount(); ++id)
+    {
+        agents.push_back(id);
+    }
+    bodyX.resize(agents.size());
+    bodyY.resize(agents.size());
+    velocityX.resize(agents.size());
+    velocityY.resize(agents.size());
+    bodySize.assign(agents.size(), agent_size);
+}
+
+int getAgentCount()
+{
+    return agents.size();
+}
+
+void updateAgents(float dt)
+{
+    if (agents.empty())
+    {
+        return;
+    }
+
+    sf::Vector2f player = getPosition();
+    sf::Vector2i target((int)floorf(player.x), (int)floorf(player.y));
+    const DistanceField &field = fields[front];
+    DistanceField &next = fields[1 - front];
+    bool rebuild = !field.valid || field.target != target || fieldChanged;
+    fieldChanged = false;
+
+    // task 0 rebuilds the field while the others steer, it goes first so it doesn't end up last
+    const int batches = (agents.size() + agent_batch - 1) / agent_batch;
+    const int first_batch = rebuild ? 1 : 0;
+    getRenderPool().run(batches + first_batch, [&](int task) {
+        if (task < first_batch)
+        {
+            buildField(next, target);
+            return;
+        }
+        int begin = (task - first_batch) * agent_batch;
+        int end = std::min(begin + agent_batch, (int)agents.size());
+        for (int i = begin; i < end; ++i)
+        {
+            sf::Vector2f position = getEntity(agents[i]).position;
+            sf::Vector2f velocity = steer(field, position, dt);
+            bodyX[i] = position.x;
+            bodyY[i] = position.y;
+            velocityX[i] = velocity.x;
+            velocityY[i] = velocity.y;
+        }
+        // agents slide along walls when their box doesn't fit through a corner
+        float *x = bodyX.data() + begin;
+        float *y = bodyY.data() + begin;
+        moveBodies(BodyBatch{x, y, velocityX.data() + begin, velocityY.data() + begin, bodySize.data() + begin,
+                             x, y, end - begin});
+    });
+
+    // the grid of the entities isn't shared between threads, moves are applied here
+    for (size_t i = 0; i < agents.size(); ++i)
+    {
+        moveEntity(agents[i], sf::Vector2f(bodyX[i], bodyY[i]));
+    }
+    if (rebuild)
+    {
+        front = 1 - front;
+    }
+}
+
+uint16_t getNavDistance(int x, int y)
+{
+    return getDistance(fields[front], x, y);
+}
@@ -0,0 +1,41 @@
+#ifndef Navigation_hpp
+#define Navigation_hpp
+#include <stdint.h>
+#include <SFML/Graphics.hpp>
+
+// Agents are entities that walk to the player. They all follow one distance field: the number of steps
+// along floor tiles from every tile to the tile of the player, searched breadth first. Each agent steps
+// to the neighbour tile closest to the player, so there's no path search per agent.
+//
+// The field covers the tiles up to nav_radius around the player and is rebuilt when the player enters
+// another tile, or when tiles it covers are set on the map. It's searched anew rather than repaired: steps
+// between tiles alternate their parity, so when the player steps to a neighbour tile the distance of every
+// tile in reach changes by one, and a repair would write all of them too. It's double buffered: the new
+// field is built on the worker pool at the same time as the agents steer on the last one, and they follow
+// it from the next tick on.
+
+// tiles around the player the field reaches, agents farther away wait
+const int nav_radius = 64;
+// side of the square the field covers
+const int nav_size = nav_radius * 2 + 1;
+// distance of tiles that can't be reached or are outside of the field
+const uint16_t nav_unreachable = 0xffff;
+// agent speed in tiles per second
+const float agent_speed = 2.5f;
+// side of the collision box of an agent, in tiles
+const float agent_size = 0.5f;
+// agents steered by one task of the worker pool
+const int agent_batch = 256;
+
+// remove all agents, the entities stay
+void clearAgents();
+// add count entities on random floor tiles as agents, the same ones for the same seed and map
+void scatterAgents(int count, unsigned seed);
+int getAgentCount();
+
+// step all agents dt seconds towards the player, rebuild the field if the player is on another tile
+void updateAgents(float dt);
+// steps from tile x, y to the player in the field the agents follow now
+uint16_t getNavDistance(int x, int y);
+
+#endif
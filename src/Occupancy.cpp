@@ -0,0 +1,136 @@
+#include "Occupancy.h"
+#include <vector>
+
+// one level of the pyramid, levels[0] is level 1
+struct OccupancyLevel
+{
+    int width;    // in cells
+    int height;
+    int chunksX;  // in words
+    int chunksY;
+    std::vector<uint64_t> bits;
+};
+
+static std::vector<OccupancyLevel> levels;
+
+// the word of cells below the given cell, for level 1 that is the solidity of a map chunk
+static uint64_t getBelow(int level, int x, int y)
+{
+    if (level == 0)
+    {
+        return getChunkSolidity(x, y);
+    }
+    const OccupancyLevel &below = levels[level - 1];
+    if (x < 0 || y < 0 || x >= below.chunksX || y >= below.chunksY)
+    {
+        return ~uint64_t(0);
+    }
+    return below.bits[(size_t)y * below.chunksX + x];
+}
+
+// recompute a single cell of a level from the level below
+static void updateCell(int level, int x, int y)
+{
+    OccupancyLevel &current = levels[level];
+    uint64_t &word = current.bits[(size_t)(y >> chunk_shift) * current.chunksX + (x >> chunk_shift)];
+    uint64_t bit = uint64_t(1) << ((y & chunk_mask) * chunk_size + (x & chunk_mask));
+    if (getBelow(level, x, y) != 0)
+        word |= bit;
+    else
+        word &= ~bit;
+}
+
+// tiles set on the map change the cells above their chunk, every rectangle is in one chunk
+static void updateChanged(void *, const MapRect *rects, int count)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        updateOccupancy(rects[i].x0, rects[i].y0);
+    }
+}
+
+void buildOccupancy()
+{
+    addMapListener(updateChanged, NULL);
+    levels.clear();
+    int width = (getMapWidth() + chunk_mask) / chunk_size;
+    int height = (getMapHeight() + chunk_mask) / chunk_size;
+    // add levels until one word covers the whole map
+    for (;;)
+    {
+        OccupancyLevel level;
+        level.width = width;
+        level.height = height;
+        level.chunksX = (width + chunk_mask) / chunk_size;
+        level.chunksY = (height + chunk_mask) / chunk_size;
+        // cells past the edge of the level are set
+        level.bits.assign((size_t)level.chunksX * level.chunksY, ~uint64_t(0));
+        levels.push_back(level);
+
+        int index = levels.size() - 1;
+        for (int y = 0; y < height; ++y)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                updateCell(index, x, y);
+            }
+        }
+        if (level.chunksX == 1 && level.chunksY == 1)
+        {
+            break;
+        }
+        width = level.chunksX;
+        height = level.chunksY;
+    }
+}
+
+void updateOccupancy(int x, int y)
+{
+    for (size_t level = 0; level < levels.size(); ++level)
+    {
+        x >>= chunk_shift;
+        y >>= chunk_shift;
+        if (x >= levels[level].width || y >= levels[level].height)
+        {
+            return;
+        }
+        updateCell(level, x, y);
+    }
+}
+
+int getEmptyBlock(int x, int y, int &block_x, int &block_y)
+{
+    int size = 0;
+    int shift = 0;
+    for (size_t level = 0; level < levels.size(); ++level)
+    {
+        shift += chunk_shift;
+        int cell_x = x >> shift;
+        int cell_y = y >> shift;
+        const OccupancyLevel &current = levels[level];
+        if (x < 0 || y < 0 || cell_x >= current.width || cell_y >= current.height)
+        {
+            break;
+        }
+        uint64_t word = current.bits[(size_t)(cell_y >> chunk_shift) * current.chunksX + (cell_x >> chunk_shift)];
+        if ((word >> ((cell_y & chunk_mask) * chunk_size + (cell_x & chunk_mask))) & 1)
+        {
+            break;
+        }
+        // the cell is empty, and so is the whole block of tiles it covers
+        size = 1 << shift;
+    }
+    block_x = x & ~(size - 1);
+    block_y = y & ~(size - 1);
+    return size;
+}
+
+const uint64_t *getChunkOccupancy()
+{
+    return levels[0].bits.data();
+}
+
+int getChunkOccupancyChunksX()
+{
+    return levels[0].chunksX;
+}
@@ -0,0 +1,25 @@
+#ifndef Occupancy_hpp
+#define Occupancy_hpp
+#include <stdint.h>
+#include "Map.h"
+
+// Hierarchical occupancy of the map, used by rays to skip empty space. Level 0 is the solidity grid
+// of the map. A cell of level k covers chunk_size x chunk_size cells of level k - 1 and is set when any of
+// them is, so every level is stored like the solidity grid: one 64 bit word per chunk of cells.
+// Cells outside of the map are always set. Tiles set on the map update the cells above their chunk.
+
+// build all levels for the loaded map
+void buildOccupancy();
+// update the levels above tile x, y after its solidity changed
+void updateOccupancy(int x, int y);
+
+// size in tiles of the largest aligned empty block containing tile x, y, and its upper left corner.
+// 0 if the chunk of the tile is not empty.
+int getEmptyBlock(int x, int y, int &block_x, int &block_y);
+
+// level 1, one bit per map chunk, for the ray packets
+const uint64_t *getChunkOccupancy();
+// number of words in a row of level 1
+int getChunkOccupancyChunksX();
+
+#endif
@@ -0,0 +1,156 @@
+#include "Pipeline.h"
+#include <string.h>
+#include "Engine.h"
+#include "Profiler.h"
+
+const char *getPipelineName(PipelineMode mode)
+{
+    switch (mode)
+    {
+    case PipelineMode::Serial:
+        return "serial";
+    case PipelineMode::Wait:
+        return "wait";
+    case PipelineMode::Drop:
+        return "drop";
+    default:
+        return "?";
+    }
+}
+
+bool parsePipelineMode(const char *name, PipelineMode &mode)
+{
+    for (PipelineMode named : {PipelineMode::Serial, PipelineMode::Wait, PipelineMode::Drop})
+    {
+        if (strcmp(name, getPipelineName(named)) == 0)
+        {
+            mode = named;
+            return true;
+        }
+    }
+    return false;
+}
+
+RenderPipeline::RenderPipeline(SfmlBackend &backend, PipelineMode mode) : backend(backend), mode(mode)
+{
+    finished.vertices = &backend.getFrame();
+    finished.camera = getPlayerState();
+    // no input is shown before the first frame
+    finished.inputMicro = -1;
+    finished.renderMicro = 0;
+    inFlight = finished;
+    previous = finished;
+    if (mode != PipelineMode::Serial)
+    {
+        // the render threads are made here, not by the first frame on the producer
+        getRenderPool();
+        producer = std::thread(&RenderPipeline::produce, this);
+    }
+}
+
+RenderPipeline::~RenderPipeline()
+{
+    if (producer.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quit = true;
+        }
+        wake.notify_one();
+        producer.join();
+    }
+}
+
+PipelineMode RenderPipeline::getMode() const
+{
+    return mode;
+}
+
+void RenderPipeline::renderFrame()
+{
+    PROFILE_SCOPE(Stage::Render);
+    sf::Clock clock;
+    render(backend, inFlight.camera);
+    inFlight.vertices = &backend.getFrame();
+    inFlight.renderMicro = clock.getElapsedTime().asMicroseconds();
+}
+
+void RenderPipeline::produce()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;)
+    {
+        wake.wait(lock, [this] { return busy || quit; });
+        if (quit)
+        {
+            return;
+        }
+        lock.unlock();
+        renderFrame();
+        lock.lock();
+        busy = false;
+        fresh = true;
+        done.notify_one();
+    }
+}
+
+void RenderPipeline::start(int64_t input_micro)
+{
+    inFlight.camera = getPlayerState();
+    inFlight.inputMicro = input_micro;
+    if (mode == PipelineMode::Serial)
+    {
+        renderFrame();
+        finished = inFlight;
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        busy = true;
+    }
+    wake.notify_one();
+}
+
+bool RenderPipeline::finish(bool wait)
+{
+    if (mode == PipelineMode::Serial)
+    {
+        return true;
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    if (wait)
+    {
+        done.wait(lock, [this] { return !busy; });
+    }
+    if (busy)
+    {
+        return false;
+    }
+    if (fresh)
+    {
+        previous = finished;
+        finished = inFlight;
+        fresh = false;
+        droppable = !dropped;
+        dropped = false;
+    }
+    return true;
+}
+
+bool RenderPipeline::drop()
+{
+    if (!droppable)
+    {
+        return false;
+    }
+    finished = previous;
+    backend.dropFrame();
+    droppable = false;
+    dropped = true;
+    return true;
+}
+
+const PipelineFrame &RenderPipeline::getFrame() const
+{
+    return finished;
+}
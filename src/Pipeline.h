@@ -0,0 +1,92 @@
+#ifndef Pipeline_hpp
+#define Pipeline_hpp
+#include <stdint.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "Player.h"
+#include "Window.h"
+
+// Renders the frames of the window on a thread of its own, so the main thread draws and presents the last
+// finished frame while the next one is raycast. The two frames of the backend take turns: one is written
+// by render(), the other one is drawn. One frame is in flight at most, seen from the camera it was started
+// with. The player can move on meanwhile, the rest of the game it renders can only change once it's
+// finished.
+
+// how the main loop takes the frames of a RenderPipeline
+enum class PipelineMode
+{
+    Serial, // no thread: render, draw and present one after another
+    Wait,   // every frame is presented, one frame late, the main thread waits for it before the next tick
+    Drop,   // the main thread never waits. While the frame in flight is late the last finished one is
+            // presented again and the player moves on, a late frame is dropped when it finishes and the next
+            // one started from where the player is then. Never two in a row, so slow frames still show.
+};
+
+// serial, wait or drop, as --pipeline takes them
+const char *getPipelineName(PipelineMode mode);
+// returns: false if name isn't one of them
+bool parsePipelineMode(const char *name, PipelineMode &mode);
+
+// a frame finished by a RenderPipeline
+struct PipelineFrame
+{
+    const FrameVertices *vertices;
+    // the player it was rendered from
+    PlayerState camera;
+    // when the input it shows was read, in the microseconds passed to start()
+    int64_t inputMicro;
+    // time render() took
+    int64_t renderMicro;
+};
+
+class RenderPipeline
+{
+public:
+    RenderPipeline(SfmlBackend &backend, PipelineMode mode);
+    ~RenderPipeline();
+
+    RenderPipeline(const RenderPipeline &) = delete;
+    RenderPipeline &operator=(const RenderPipeline &) = delete;
+
+    PipelineMode getMode() const;
+    // render a frame of the game as it is now, seen by the player, on the thread of the pipeline unless
+    // it's serial. The player is taken as it is, nothing else render() reads may change until finish()
+    // returns true: the map, entities, doors and the render settings.
+    // input_micro: when the input the frame shows was read
+    void start(int64_t input_micro);
+    // is the frame started last finished? Then it becomes the one getFrame() returns.
+    // wait: block until it's finished
+    bool finish(bool wait);
+    // throw away the frame finish() just took, the one before is presented again and the next frame is
+    // rendered over it. Not if the frame before was dropped too.
+    // returns: false if the frame was kept
+    bool drop();
+    // the last finished frame, its vertices stay as they are until the frame after the next one is started
+    const PipelineFrame &getFrame() const;
+
+private:
+    void produce();
+    void renderFrame();
+
+    SfmlBackend &backend;
+    PipelineMode mode;
+    // written by the thread of the pipeline while a frame is in flight
+    PipelineFrame inFlight;
+    PipelineFrame finished;
+    // the frame finished before, for drop()
+    PipelineFrame previous;
+    // can drop() throw away the frame finish() took last? Not if the one before was dropped.
+    bool droppable = false;
+    bool dropped = false;
+    std::thread producer;
+    std::mutex mutex;
+    std::condition_variable wake; // the producer waits here for a frame to start
+    std::condition_variable done; // finish() waits here for the frame in flight
+    bool busy = false;
+    // a frame finished that finish() didn't take yet
+    bool fresh = false;
+    bool quit = false;
+};
+
+#endif
@@ -1,30 +1,22 @@
 #include "Player.h"
+#include "Movement.h"
 
 sf::Vector2f position(15.5f, 16.5f); // coordinates in worldMap
 sf::Vector2f direction(1.0f, 0.0f);  // direction, relative to (0,0)
-sf::Vector2f plane(0.0f, 0.66f);    // 2d raycaster version of the camera plane,
+sf::Vector2f plane(0.0f, cameraPlane); // 2d raycaster version of the camera plane,
 
-// check if a rectangular thing with given size can move to given position without colliding with walls or
+// check if the player collision box can move to given position without colliding with walls or
 // being outside of the map
-// position is considered the middle of the rectangle
+// position is considered the middle of the box
 bool canMove(sf::Vector2f position) {
-    // player collision box width and height, derived from collision_box must be perpendicular to rotation
-    sf::Vector2f size(collision_box, collision_box);
-    // create the corners of the rectangle
-    sf::Vector2i upper_left(position - size / 2.0f);
-    sf::Vector2i lower_right(position + size / 2.0f);
-    if (upper_left.x < 0 || upper_left.y < 0 || lower_right.x >= mapWidth || lower_right.y >= mapHeight) {
-        return false; // out of map bounds
-    }
-    // loop through each map tile within the rectangle. The rectangle could be multiple tiles in size!
-    for (int y = upper_left.y; y <= lower_right.y; ++y) {
-        for (int x = upper_left.x; x <= lower_right.x; ++x) {
-            if (getTile(x, y) != '.') {
-                return false;
-            }
-        }
-    }
-    return true;
+    return isBoxFree(position, collision_box);
+}
+
+// move the player by moveVec, sliding along walls: each axis is only taken if the box fits there
+static void slide(sf::Vector2f moveVec) {
+    float size = collision_box;
+    BodyBatch body{&position.x, &position.y, &moveVec.x, &moveVec.y, &size, &position.x, &position.y, 1};
+    moveBodies(body);
 }
 
 // rotate a given vector with given float value in radians and return the result
@@ -34,35 +26,27 @@ sf::Vector2f rotateVec(sf::Vector2f vec, float value) {
             vec.x * std::sin(value) + vec.y * std::cos(value));
 }
 
-void handleMove(float dt) {
-    using kb = sf::Keyboard;
-
+void handleMove(uint8_t input, float dt) {
     // moving forward or backwards (1.0 or -1.0)
     float moveDirection = 0.0f;
     // rotating rightwards or leftwards(1.0 or -1.0)
     float rotateDirection = 0.0f;
     // vertical move or shifted
-    bool vertical = true;
+    bool vertical = !(input & input_strafe);
 
-    if (kb::isKeyPressed(kb::Left))
+    if (input & input_left)
         rotateDirection = -1.0f;
-    else if (kb::isKeyPressed(kb::Right))
+    else if (input & input_right)
         rotateDirection = 1.0f;
-    if (kb::isKeyPressed(kb::LShift))
-        vertical = false;
-    if (kb::isKeyPressed(kb::Up))
+    if (input & input_forward)
         moveDirection = 1.0f;
-    else if (kb::isKeyPressed(kb::Down))
+    else if (input & input_back)
         moveDirection = -1.0f;
 
     // handle movement
     if (moveDirection != 0.0f && vertical) {
         sf::Vector2f moveVec = direction * moveSpeed * moveDirection * dt;
-
-        if (canMove(sf::Vector2f(position.x + moveVec.x, position.y)))
-            position.x += moveVec.x;
-        if (canMove(sf::Vector2f(position.x, position.y + moveVec.y)))
-            position.y += moveVec.y;
+        slide(moveVec);
     }
 
     // handle rotation
@@ -74,19 +58,43 @@ void handleMove(float dt) {
         } else {
             sf::Vector2f dir = rotateVec(direction, rotation + M_PI / 2);
             sf::Vector2f moveVec = dir * moveSpeed * rotateDirection * dt;
-
-            if (canMove(sf::Vector2f(position.x + moveVec.x, position.y)))
-                position.x += moveVec.x;
-            if (canMove(sf::Vector2f(position.x, position.y + moveVec.y)))
-                position.y += moveVec.y;
+            slide(moveVec);
         }
     }
 }
 
+PlayerState getPlayerState() {
+    return PlayerState{position, direction, plane};
+}
+
+void setPlayerState(const PlayerState &state) {
+    position = state.position;
+    direction = state.direction;
+    plane = state.plane;
+}
+
+PlayerState interpolatePlayer(const PlayerState &from, const PlayerState &to, float alpha) {
+    // the direction turns by a small angle per tick, so blending and normalizing it is close enough
+    sf::Vector2f dir = from.direction + (to.direction - from.direction) * alpha;
+    dir = dir / std::sqrt(dir.x * dir.x + dir.y * dir.y);
+    sf::Vector2f view_plane = from.plane + (to.plane - from.plane) * alpha;
+    view_plane = view_plane * (cameraPlane / std::sqrt(view_plane.x * view_plane.x + view_plane.y * view_plane.y));
+    return PlayerState{from.position + (to.position - from.position) * alpha, dir, view_plane};
+}
+
+void setPosition(sf::Vector2f value) {
+    position = value;
+}
+
 sf::Vector2f getPosition() {
     return position;
 }
 
+void setDirection(sf::Vector2f value) {
+    direction = value;
+    plane = sf::Vector2f(-value.y, value.x) * cameraPlane;
+}
+
 sf::Vector2f getDirection() {
     return direction;
 }
@@ -3,20 +3,41 @@
 
 #include <SFML/Graphics.hpp>
 #include <math.h>
+#include "Input.h"
 #include "Map.h"
 
 const float collision_box = 0.375; // dimensions of player collision box, in tiles
 const float moveSpeed = 4;       // player movement speed in tiles per second
 const float rotateSpeed = 2.0;     // player rotation speed in radians per second
+const float cameraPlane = 0.66f;   // length of the camera plane, relative to the direction, sets the field of view
 
 bool canMove(sf::Vector2f);
 
-void handleMove(float);
+// where the player is and looks at
+struct PlayerState
+{
+    sf::Vector2f position;
+    sf::Vector2f direction;
+    sf::Vector2f plane;
+};
+
+// move and turn the player by input (bits of Input.h) held down for dt seconds
+void handleMove(uint8_t input, float dt);
+
+PlayerState getPlayerState();
+void setPlayerState(const PlayerState &);
+// state between from and to, alpha 0 is from and 1 is to
+PlayerState interpolatePlayer(const PlayerState &from, const PlayerState &to, float alpha);
 
 sf::Vector2f rotateVec(sf::Vector2f, float);
 
+void setPosition(sf::Vector2f);
+
 sf::Vector2f getPosition();
 
+// set the direction the player looks at, a unit vector. The camera plane turns with it.
+void setDirection(sf::Vector2f);
+
 sf::Vector2f getDirection();
 
 sf::Vector2f getPlane();
@@ -0,0 +1,237 @@
+#include "Profiler.h"
+
+#ifdef PROFILING
+#include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+// samples a thread can record between two collectProfile() calls, a power of two
+const uint32_t ring_size = 4096;
+// threads that get a ring, samples of any more are dropped
+const int max_profiled_threads = 64;
+// recent samples of every stage the percentiles are taken from
+const int stage_window = 512;
+
+struct Sample
+{
+    int64_t start; // nanoseconds
+    int64_t end;
+    Stage stage;
+    int thread;
+};
+
+// single producer, single consumer queue: the thread it belongs to pushes at head,
+// collectProfile() pops at tail
+struct SampleRing
+{
+    Sample samples[ring_size];
+    std::atomic<uint32_t> head{0};
+    std::atomic<uint32_t> tail{0};
+};
+
+static SampleRing rings[max_profiled_threads];
+static std::atomic<int> ringCount{0};
+static std::atomic<long> dropped{0};
+
+// index of the ring of the calling thread, -1 until it records the first sample
+static thread_local int threadRing = -1;
+
+// recent durations of every stage, in nanoseconds, written round robin
+static int64_t durations[(int)Stage::Count][stage_window];
+static int durationCount[(int)Stage::Count];
+static bool recording = false;
+static std::vector<Sample> recorded;
+
+static int64_t now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+static void push(const Sample &sample)
+{
+    SampleRing &ring = rings[sample.thread];
+    uint32_t head = ring.head.load(std::memory_order_relaxed);
+    if (head - ring.tail.load(std::memory_order_acquire) >= ring_size)
+    {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    ring.samples[head & (ring_size - 1)] = sample;
+    ring.head.store(head + 1, std::memory_order_release);
+}
+
+ProfileScope::ProfileScope(Stage stage) : stage(stage), start(now())
+{
+}
+
+ProfileScope::~ProfileScope()
+{
+    int64_t end = now();
+    if (threadRing < 0)
+    {
+        threadRing = ringCount.fetch_add(1);
+    }
+    if (threadRing >= max_profiled_threads)
+    {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    push(Sample{start, end, stage, threadRing});
+}
+
+const char *getStageName(Stage stage)
+{
+    switch (stage)
+    {
+    case Stage::Input:
+        return "input";
+    case Stage::Render:
+        return "render";
+    case Stage::Rows:
+        return "rows";
+    case Stage::Walls:
+        return "walls";
+    case Stage::Sprites:
+        return "sprites";
+    case Stage::Handoff:
+        return "handoff";
+    case Stage::Minimap:
+        return "minimap";
+    case Stage::Draw:
+        return "draw";
+    case Stage::Display:
+        return "display";
+    case Stage::Wait:
+        return "wait";
+    default:
+        return "?";
+    }
+}
+
+void collectProfile()
+{
+    int threads = std::min(ringCount.load(), max_profiled_threads);
+    for (int i = 0; i < threads; ++i)
+    {
+        SampleRing &ring = rings[i];
+        uint32_t head = ring.head.load(std::memory_order_acquire);
+        for (uint32_t tail = ring.tail.load(std::memory_order_relaxed); tail != head; ++tail)
+        {
+            const Sample &sample = ring.samples[tail & (ring_size - 1)];
+            int stage = (int)sample.stage;
+            durations[stage][durationCount[stage]++ % stage_window] = sample.end - sample.start;
+            if (recording)
+            {
+                recorded.push_back(sample);
+            }
+        }
+        ring.tail.store(head, std::memory_order_release);
+    }
+}
+
+StageTimes getStageTimes(Stage stage)
+{
+    int count = std::min(durationCount[(int)stage], stage_window);
+    if (count == 0)
+    {
+        return StageTimes{0.0f, 0.0f, 0.0f, 0};
+    }
+
+    // sorted copy, so the window keeps its order
+    int64_t sorted[stage_window];
+    std::copy(durations[(int)stage], durations[(int)stage] + count, sorted);
+    std::sort(sorted, sorted + count);
+    auto percentile = [&](int p) { return sorted[(count - 1) * p / 100] / 1000.0f; };
+    return StageTimes{percentile(50), percentile(95), percentile(99), count};
+}
+
+void formatProfile(char *buffer, size_t size)
+{
+    int length = snprintf(buffer, size, "%-8s %8s %8s %8s us", "", "p50", "p95", "p99");
+    for (int stage = 0; stage < (int)Stage::Count; ++stage)
+    {
+        StageTimes times = getStageTimes((Stage)stage);
+        if (times.samples > 0 && length >= 0 && (size_t)length < size)
+        {
+            length += snprintf(buffer + length, size - length, "\n%-8s %8.1f %8.1f %8.1f", getStageName((Stage)stage),
+                               times.p50, times.p95, times.p99);
+        }
+    }
+    long lost = dropped.load(std::memory_order_relaxed);
+    if (lost > 0 && length >= 0 && (size_t)length < size)
+    {
+        snprintf(buffer + length, size - length, "\n%ld samples dropped", lost);
+    }
+}
+
+void setProfileRecording(bool record)
+{
+    recording = record;
+    if (record)
+    {
+        // room for a few thousand frames, so collecting them doesn't reallocate
+        recorded.reserve(1 << 20);
+    }
+}
+
+// start of the first recorded sample, files count time from it
+static int64_t getRecordingStart()
+{
+    int64_t start = recorded.empty() ? 0 : recorded[0].start;
+    for (const Sample &sample : recorded)
+    {
+        start = std::min(start, sample.start);
+    }
+    return start;
+}
+
+bool writeProfileCsv(const char *path)
+{
+    FILE *file = fopen(path, "w");
+    if (!file)
+    {
+        return false;
+    }
+    int64_t start = getRecordingStart();
+    fprintf(file, "thread,stage,start_us,duration_us\n");
+    for (const Sample &sample : recorded)
+    {
+        fprintf(file, "%d,%s,%.3f,%.3f\n", sample.thread, getStageName(sample.stage), (sample.start - start) / 1000.0,
+                (sample.end - sample.start) / 1000.0);
+    }
+    return fclose(file) == 0;
+}
+
+bool writeProfileTrace(const char *path)
+{
+    FILE *file = fopen(path, "w");
+    if (!file)
+    {
+        return false;
+    }
+    int64_t start = getRecordingStart();
+    fprintf(file, "{\"traceEvents\":[");
+    const char *separator = "\n";
+    // names of the timelines, the thread that records first is the one running the frame loop
+    int threads = std::min(ringCount.load(), max_profiled_threads);
+    for (int i = 0; i < threads; ++i)
+    {
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,\"args\":{\"name\":\"%s %d\"}}",
+                separator, i, i == 0 ? "main" : "thread", i);
+        separator = ",\n";
+    }
+    for (const Sample &sample : recorded)
+    {
+        fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", separator,
+                getStageName(sample.stage), sample.thread, (sample.start - start) / 1000.0,
+                (sample.end - sample.start) / 1000.0);
+        separator = ",\n";
+    }
+    fprintf(file, "\n]}\n");
+    return fclose(file) == 0;
+}
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef Profiler_hpp
+#define Profiler_hpp
+#include <stddef.h>
+#include <stdint.h>
+
+// Timing of the stages of a frame. Built with -DPROFILING (make profile) every PROFILE_SCOPE records
+// its start and end into a lock-free ring of the thread it runs on, otherwise PROFILE_SCOPE expands to
+// nothing and none of this is compiled.
+
+// timed stages, a stage can be timed on any thread and inside of another one
+enum class Stage
+{
+    Input,   // input and the simulation ticks due
+    Render,  // the whole render()
+    Rows,    // one block of floor and ceiling rows
+    Walls,   // one slice of wall columns
+    Sprites, // culling the sprites, and one slice of their columns
+    Handoff, // passing the finished geometry on at the end of render()
+    Minimap,
+    Draw,    // drawing the view and the text
+    Display, // window.display()
+    Wait,    // the main loop waiting for the frame in flight of the render pipeline
+    Count
+};
+
+#ifdef PROFILING
+
+#define PROFILE_NAME_(name, line) name##line
+#define PROFILE_NAME(name, line) PROFILE_NAME_(name, line)
+#define PROFILE_SCOPE(stage) ProfileScope PROFILE_NAME(profile_scope_, __LINE__)(stage)
+
+// records the time from its construction to its destruction as a sample of stage
+class ProfileScope
+{
+public:
+    explicit ProfileScope(Stage stage);
+    ~ProfileScope();
+
+    ProfileScope(const ProfileScope &) = delete;
+    ProfileScope &operator=(const ProfileScope &) = delete;
+
+private:
+    Stage stage;
+    int64_t start;
+};
+
+// percentiles of the recent samples of a stage, in microseconds
+struct StageTimes
+{
+    float p50;
+    float p95;
+    float p99;
+    int samples;
+};
+
+const char *getStageName(Stage stage);
+
+// move the samples out of the rings of all threads. Only one thread may call it, threads whose ring
+// is full drop their samples until then.
+void collectProfile();
+StageTimes getStageTimes(Stage stage);
+// one line with the percentiles of every stage that has samples
+void formatProfile(char *buffer, size_t size);
+
+// keep every collected sample for writing it to a file later
+void setProfileRecording(bool record);
+// thread, stage, start and duration of every recorded sample
+bool writeProfileCsv(const char *path);
+// recorded samples as Chrome trace events (chrome://tracing, Perfetto), one timeline per thread
+bool writeProfileTrace(const char *path);
+
+#else
+
+#define PROFILE_SCOPE(stage)
+
+#endif
+
+#endif
@@ -0,0 +1,540 @@
+#include "Raycast.h"
+#include <math.h>
+#include <algorithm>
+#include "Dda.h"
+#include "Engine.h"
+#include "Occupancy.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define RAYCAST_X86
+#include <immintrin.h>
+#endif
+
+static RaycastSimd simd = detectRaycastSimd();
+static bool skipping = true;
+
+int getMaxRaySteps()
+{
+    return getMapWidth() + getMapHeight();
+}
+
+void setEmptySpaceSkipping(bool skip)
+{
+    skipping = skip;
+}
+
+bool getEmptySpaceSkipping()
+{
+    return skipping;
+}
+
+RaycastSimd detectRaycastSimd()
+{
+#ifdef RAYCAST_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return RaycastSimd::AVX2;
+    if (__builtin_cpu_supports("sse4.1"))
+        return RaycastSimd::SSE41;
+#endif
+    return RaycastSimd::Scalar;
+}
+
+void setRaycastSimd(RaycastSimd wanted)
+{
+    simd = (int)wanted <= (int)detectRaycastSimd() ? wanted : detectRaycastSimd();
+}
+
+RaycastSimd getRaycastSimd()
+{
+    return simd;
+}
+
+const char *getRaycastSimdName(RaycastSimd simd)
+{
+    switch (simd)
+    {
+    case RaycastSimd::AVX2:
+        return "avx2";
+    case RaycastSimd::SSE41:
+        return "sse4.1";
+    default:
+        return "scalar";
+    }
+}
+
+// calculate where the wall was hit and the x coordinate on the wall texture
+static void hitWall(RayPacket &packet, int i, const DdaRay &ray)
+{
+    float wall_x;
+    if (ray.horizontal)
+    {
+        wall_x = ray.pos.y + ray.distance * ray.dir.y;
+    }
+    else
+    {
+        wall_x = ray.pos.x + ray.distance * ray.dir.x;
+    }
+    wall_x -= floor(wall_x);
+
+    // get x coordinate on the wall texture
+    int tex_x = int(wall_x * float(texture_wall_size));
+
+    // flip texture if we see it on the other side of us, this prevents a mirrored effect for the texture
+    if ((ray.horizontal && ray.dir.x <= 0) || (!ray.horizontal && ray.dir.y >= 0))
+    {
+        tex_x = texture_wall_size - tex_x - 1;
+    }
+
+    packet.mapX[i] = ray.mapPos.x;
+    packet.mapY[i] = ray.mapPos.y;
+    packet.tile[i] = getTile(ray.mapPos.x, ray.mapPos.y);
+    packet.horizontal[i] = ray.horizontal;
+    packet.distance[i] = ray.distance;
+    packet.wall_x[i] = wall_x;
+    packet.tex_x[i] = tex_x;
+}
+
+void hitFace(sf::Vector2f rayPos, RayPacket &packet, int i, sf::Vector2i mapPos, bool horizontal)
+{
+    DdaRay ray;
+    ray.pos = rayPos;
+    ray.dir = sf::Vector2f(packet.dirX[i], packet.dirY[i]);
+    ray.step = sf::Vector2i(ray.dir.x < 0.0f ? -1 : 1, ray.dir.y < 0.0f ? -1 : 1);
+    ray.mapPos = mapPos;
+    ray.horizontal = horizontal;
+    ray.distance = horizontal ? distanceX(ray) : distanceY(ray);
+    packet.steps[i] = 0;
+    hitWall(packet, i, ray);
+}
+
+// one ray at a time, the reference for the packet versions
+static void castRaysScalar(sf::Vector2f rayPos, RayPacket &packet, int count)
+{
+    const int max_ray_steps = getMaxRaySteps();
+    for (int i = 0; i < count; ++i)
+    {
+        DdaRay ray;
+        initRay(ray, rayPos, sf::Vector2f(packet.dirX[i], packet.dirY[i]));
+
+        SolidityCursor cursor;
+        cursor.isSolid(ray.mapPos.x, ray.mapPos.y);
+        bool hit = false;
+        int steps = 0;
+
+        // cast the ray until we hit a wall
+        while (!hit && steps < max_ray_steps)
+        {
+            int crossed = skipping && cursor.isChunkEmpty() ? trySkip(ray) : 0;
+            if (!crossed)
+            {
+                stepRay(ray);
+                crossed = 1;
+            }
+            packet.linesCrossed += crossed;
+            ++steps;
+            hit = cursor.isSolid(ray.mapPos.x, ray.mapPos.y);
+        }
+
+        packet.stepsTaken += steps;
+        packet.steps[i] = steps;
+        hitWall(packet, i, ray);
+    }
+}
+
+#ifdef RAYCAST_X86
+
+// The packet versions do exactly the float operations of castRaysScalar, in the same order, on 4 or 8
+// rays at once. Rays that already hit a wall are masked out and keep their results until the
+// whole packet is done. Every ray takes one step per iteration, rays in an empty chunk leave the
+// registers for it and skip the chunk with skipBlock().
+
+// lane state spilled to memory for skipBlock()
+struct PacketLanes
+{
+    alignas(32) float deltaX[RayPacket::size];
+    alignas(32) float deltaY[RayPacket::size];
+    alignas(32) float offsetX[RayPacket::size];
+    alignas(32) float offsetY[RayPacket::size];
+    alignas(32) int stepX[RayPacket::size];
+    alignas(32) int stepY[RayPacket::size];
+    alignas(32) int mapX[RayPacket::size];
+    alignas(32) int mapY[RayPacket::size];
+    alignas(32) int takenX[RayPacket::size];
+    alignas(32) int takenY[RayPacket::size];
+    alignas(32) int horizontal[RayPacket::size];
+    alignas(32) float distance[RayPacket::size];
+};
+
+// skip the empty blocks of the lanes in mask
+// returns: number of grid lines crossed by all of them
+static int skipLanes(sf::Vector2f rayPos, const RayPacket &packet, int first, PacketLanes &lanes, int mask)
+{
+    int crossed = 0;
+    while (mask)
+    {
+        int i = __builtin_ctz(mask);
+        mask &= mask - 1;
+
+        DdaRay ray;
+        ray.pos = rayPos;
+        ray.dir = sf::Vector2f(packet.dirX[first + i], packet.dirY[first + i]);
+        ray.delta = sf::Vector2f(lanes.deltaX[i], lanes.deltaY[i]);
+        ray.offset = sf::Vector2f(lanes.offsetX[i], lanes.offsetY[i]);
+        ray.step = sf::Vector2i(lanes.stepX[i], lanes.stepY[i]);
+        ray.mapPos = sf::Vector2i(lanes.mapX[i], lanes.mapY[i]);
+        ray.taken = sf::Vector2i(lanes.takenX[i], lanes.takenY[i]);
+
+        crossed += trySkip(ray);
+
+        lanes.mapX[i] = ray.mapPos.x;
+        lanes.mapY[i] = ray.mapPos.y;
+        lanes.takenX[i] = ray.taken.x;
+        lanes.takenY[i] = ray.taken.y;
+        lanes.horizontal[i] = ray.horizontal ? -1 : 0;
+        lanes.distance[i] = ray.distance;
+    }
+    return crossed;
+}
+
+__attribute__((target("sse4.1")))
+static void castRaysSSE41(sf::Vector2f rayPos, RayPacket &packet, int first, int count)
+{
+    const int max_ray_steps = getMaxRaySteps();
+    const int mapWidth = getMapWidth();
+    const int mapHeight = getMapHeight();
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128i laneBits = _mm_setr_epi32(1, 2, 4, 8);
+    const sf::Vector2i mapPos(rayPos);
+    PacketLanes lanes;
+
+    const __m128 dirX = _mm_load_ps(packet.dirX + first);
+    const __m128 dirY = _mm_load_ps(packet.dirY + first);
+    const __m128 deltaX = _mm_sqrt_ps(_mm_add_ps(one, _mm_div_ps(_mm_mul_ps(dirY, dirY), _mm_mul_ps(dirX, dirX))));
+    const __m128 deltaY = _mm_sqrt_ps(_mm_add_ps(one, _mm_div_ps(_mm_mul_ps(dirX, dirX), _mm_mul_ps(dirY, dirY))));
+
+    // rays going into negative direction step by -1 and have (1 - step) / 2 == 1
+    const __m128 negX = _mm_cmplt_ps(dirX, zero);
+    const __m128 negY = _mm_cmplt_ps(dirY, zero);
+    const __m128i stepX = _mm_blendv_epi8(_mm_set1_epi32(1), _mm_set1_epi32(-1), _mm_castps_si128(negX));
+    const __m128i stepY = _mm_blendv_epi8(_mm_set1_epi32(1), _mm_set1_epi32(-1), _mm_castps_si128(negY));
+    const __m128 halfX = _mm_and_ps(negX, one);
+    const __m128 halfY = _mm_and_ps(negY, one);
+    const __m128 posX = _mm_set1_ps(rayPos.x);
+    const __m128 posY = _mm_set1_ps(rayPos.y);
+    const __m128 offsetX = _mm_blendv_ps(_mm_set1_ps(mapPos.x + 1.0f - rayPos.x), _mm_set1_ps(rayPos.x - mapPos.x), negX);
+    const __m128 offsetY = _mm_blendv_ps(_mm_set1_ps(mapPos.y + 1.0f - rayPos.y), _mm_set1_ps(rayPos.y - mapPos.y), negY);
+    _mm_store_ps(lanes.deltaX, deltaX);
+    _mm_store_ps(lanes.deltaY, deltaY);
+    _mm_store_ps(lanes.offsetX, offsetX);
+    _mm_store_ps(lanes.offsetY, offsetY);
+    _mm_store_si128((__m128i *)lanes.stepX, stepX);
+    _mm_store_si128((__m128i *)lanes.stepY, stepY);
+
+    __m128i mapX = _mm_set1_epi32(mapPos.x);
+    __m128i mapY = _mm_set1_epi32(mapPos.y);
+    __m128i takenX = _mm_setzero_si128();
+    __m128i takenY = _mm_setzero_si128();
+    __m128 horizontal = zero;
+    __m128 distance = zero;
+    // lanes past count are never active
+    __m128 active = _mm_castsi128_ps(_mm_cmpgt_epi32(_mm_set1_epi32(count), _mm_setr_epi32(0, 1, 2, 3)));
+
+    const uint64_t *solidity = getSolidity();
+    const int chunksX = getMapChunksX();
+    const uint64_t *occupancy = getChunkOccupancy();
+    const int occupancyChunksX = getChunkOccupancyChunksX();
+    alignas(16) int chunks[4];
+    alignas(16) int bits[4];
+    int steps = 0;
+    while (_mm_movemask_ps(active) && steps < max_ray_steps)
+    {
+        // rays in a chunk that is empty in the occupancy pyramid skip it, the others step.
+        // Active rays are never outside of the map.
+        int skip = 0;
+        if (skipping)
+        {
+            const __m128i cellX = _mm_srai_epi32(mapX, chunk_shift);
+            const __m128i cellY = _mm_srai_epi32(mapY, chunk_shift);
+            _mm_store_si128((__m128i *)chunks, _mm_add_epi32(_mm_mullo_epi32(_mm_srai_epi32(cellY, chunk_shift), _mm_set1_epi32(occupancyChunksX)),
+                                                             _mm_srai_epi32(cellX, chunk_shift)));
+            _mm_store_si128((__m128i *)bits, _mm_add_epi32(_mm_slli_epi32(_mm_and_si128(cellY, _mm_set1_epi32(chunk_mask)), chunk_shift),
+                                                           _mm_and_si128(cellX, _mm_set1_epi32(chunk_mask))));
+            const int was_active = _mm_movemask_ps(active);
+            for (int i = 0; i < 4; ++i)
+            {
+                if ((was_active & (1 << i)) && !((occupancy[chunks[i]] >> bits[i]) & 1))
+                {
+                    skip |= 1 << i;
+                }
+            }
+        }
+        const __m128 skipMask = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(skip), laneBits), laneBits));
+        const __m128 stepping = _mm_andnot_ps(skipMask, active);
+
+        const __m128 takeX = _mm_cmplt_ps(_mm_mul_ps(_mm_add_ps(_mm_cvtepi32_ps(takenX), offsetX), deltaX),
+                                          _mm_mul_ps(_mm_add_ps(_mm_cvtepi32_ps(takenY), offsetY), deltaY));
+        const __m128 moveX = _mm_and_ps(takeX, stepping);
+        const __m128 moveY = _mm_andnot_ps(takeX, stepping);
+
+        takenX = _mm_sub_epi32(takenX, _mm_castps_si128(moveX));
+        takenY = _mm_sub_epi32(takenY, _mm_castps_si128(moveY));
+        mapX = _mm_blendv_epi8(mapX, _mm_add_epi32(mapX, stepX), _mm_castps_si128(moveX));
+        mapY = _mm_blendv_epi8(mapY, _mm_add_epi32(mapY, stepY), _mm_castps_si128(moveY));
+        horizontal = _mm_blendv_ps(horizontal, takeX, stepping);
+
+        const __m128 distX = _mm_div_ps(_mm_add_ps(_mm_sub_ps(_mm_cvtepi32_ps(mapX), posX), halfX), dirX);
+        const __m128 distY = _mm_div_ps(_mm_add_ps(_mm_sub_ps(_mm_cvtepi32_ps(mapY), posY), halfY), dirY);
+        distance = _mm_blendv_ps(distance, _mm_blendv_ps(distY, distX, takeX), stepping);
+        packet.linesCrossed += __builtin_popcount(_mm_movemask_ps(stepping));
+
+        if (skip)
+        {
+            _mm_store_si128((__m128i *)lanes.mapX, mapX);
+            _mm_store_si128((__m128i *)lanes.mapY, mapY);
+            _mm_store_si128((__m128i *)lanes.takenX, takenX);
+            _mm_store_si128((__m128i *)lanes.takenY, takenY);
+            _mm_store_ps((float *)lanes.horizontal, horizontal);
+            _mm_store_ps(lanes.distance, distance);
+            packet.linesCrossed += skipLanes(rayPos, packet, first, lanes, skip);
+            mapX = _mm_load_si128((const __m128i *)lanes.mapX);
+            mapY = _mm_load_si128((const __m128i *)lanes.mapY);
+            takenX = _mm_load_si128((const __m128i *)lanes.takenX);
+            takenY = _mm_load_si128((const __m128i *)lanes.takenY);
+            horizontal = _mm_load_ps((const float *)lanes.horizontal);
+            distance = _mm_load_ps(lanes.distance);
+        }
+
+        ++steps;
+
+        // look up the solidity bits, finished lanes still point at their wall.
+        // Lanes outside of the map are solid.
+        const __m128i inside = _mm_and_si128(
+            _mm_and_si128(_mm_cmpgt_epi32(mapX, _mm_set1_epi32(-1)), _mm_cmpgt_epi32(_mm_set1_epi32(mapWidth), mapX)),
+            _mm_and_si128(_mm_cmpgt_epi32(mapY, _mm_set1_epi32(-1)), _mm_cmpgt_epi32(_mm_set1_epi32(mapHeight), mapY)));
+        const __m128i chunk = _mm_add_epi32(_mm_mullo_epi32(_mm_srai_epi32(mapY, chunk_shift), _mm_set1_epi32(chunksX)),
+                                            _mm_srai_epi32(mapX, chunk_shift));
+        const __m128i bit = _mm_add_epi32(_mm_slli_epi32(_mm_and_si128(mapY, _mm_set1_epi32(chunk_mask)), chunk_shift),
+                                          _mm_and_si128(mapX, _mm_set1_epi32(chunk_mask)));
+        _mm_store_si128((__m128i *)chunks, chunk);
+        _mm_store_si128((__m128i *)bits, bit);
+        const int was_active = _mm_movemask_ps(active);
+        const int was_inside = _mm_movemask_ps(_mm_castsi128_ps(inside));
+        // no gather in SSE, test the bits one by one
+        int hit = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            if (!(was_inside & (1 << i)) || ((solidity[chunks[i]] >> bits[i]) & 1))
+            {
+                hit |= 1 << i;
+            }
+        }
+        hit &= was_active;
+        active = _mm_andnot_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(hit), laneBits), laneBits)), active);
+        while (hit)
+        {
+            packet.steps[first + __builtin_ctz(hit)] = steps;
+            packet.stepsTaken += steps;
+            hit &= hit - 1;
+        }
+    }
+
+    // calculate where the wall was hit and the x coordinate on the wall texture
+    __m128 wall_x = _mm_blendv_ps(_mm_add_ps(posX, _mm_mul_ps(distance, dirX)), _mm_add_ps(posY, _mm_mul_ps(distance, dirY)), horizontal);
+    wall_x = _mm_sub_ps(wall_x, _mm_floor_ps(wall_x));
+    __m128i tex_x = _mm_cvttps_epi32(_mm_mul_ps(wall_x, _mm_set1_ps(float(texture_wall_size))));
+    // flip texture if we see it on the other side of us
+    const __m128 flip = _mm_or_ps(_mm_and_ps(horizontal, _mm_cmple_ps(dirX, zero)), _mm_andnot_ps(horizontal, _mm_cmpge_ps(dirY, zero)));
+    tex_x = _mm_blendv_epi8(tex_x, _mm_sub_epi32(_mm_set1_epi32(texture_wall_size - 1), tex_x), _mm_castps_si128(flip));
+
+    _mm_store_si128((__m128i *)(packet.mapX + first), mapX);
+    _mm_store_si128((__m128i *)(packet.mapY + first), mapY);
+    for (int i = 0; i < count; ++i)
+    {
+        packet.tile[first + i] = getTile(packet.mapX[first + i], packet.mapY[first + i]);
+    }
+    _mm_store_ps(packet.distance + first, distance);
+    _mm_store_ps(packet.wall_x + first, wall_x);
+    _mm_store_si128((__m128i *)(packet.tex_x + first), tex_x);
+    const int horizontalBits = _mm_movemask_ps(horizontal);
+    for (int i = 0; i < 4; ++i)
+    {
+        packet.horizontal[first + i] = horizontalBits & (1 << i);
+    }
+}
+
+__attribute__((target("avx2")))
+static void castRaysAVX2(sf::Vector2f rayPos, RayPacket &packet, int count)
+{
+    const int max_ray_steps = getMaxRaySteps();
+    const int mapWidth = getMapWidth();
+    const int mapHeight = getMapHeight();
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const sf::Vector2i mapPos(rayPos);
+    PacketLanes lanes;
+
+    const __m256 dirX = _mm256_load_ps(packet.dirX);
+    const __m256 dirY = _mm256_load_ps(packet.dirY);
+    const __m256 deltaX = _mm256_sqrt_ps(_mm256_add_ps(one, _mm256_div_ps(_mm256_mul_ps(dirY, dirY), _mm256_mul_ps(dirX, dirX))));
+    const __m256 deltaY = _mm256_sqrt_ps(_mm256_add_ps(one, _mm256_div_ps(_mm256_mul_ps(dirX, dirX), _mm256_mul_ps(dirY, dirY))));
+
+    // rays going into negative direction step by -1 and have (1 - step) / 2 == 1
+    const __m256 negX = _mm256_cmp_ps(dirX, zero, _CMP_LT_OQ);
+    const __m256 negY = _mm256_cmp_ps(dirY, zero, _CMP_LT_OQ);
+    const __m256i stepX = _mm256_blendv_epi8(_mm256_set1_epi32(1), _mm256_set1_epi32(-1), _mm256_castps_si256(negX));
+    const __m256i stepY = _mm256_blendv_epi8(_mm256_set1_epi32(1), _mm256_set1_epi32(-1), _mm256_castps_si256(negY));
+    const __m256 halfX = _mm256_and_ps(negX, one);
+    const __m256 halfY = _mm256_and_ps(negY, one);
+    const __m256 posX = _mm256_set1_ps(rayPos.x);
+    const __m256 posY = _mm256_set1_ps(rayPos.y);
+    const __m256 offsetX = _mm256_blendv_ps(_mm256_set1_ps(mapPos.x + 1.0f - rayPos.x), _mm256_set1_ps(rayPos.x - mapPos.x), negX);
+    const __m256 offsetY = _mm256_blendv_ps(_mm256_set1_ps(mapPos.y + 1.0f - rayPos.y), _mm256_set1_ps(rayPos.y - mapPos.y), negY);
+    _mm256_store_ps(lanes.deltaX, deltaX);
+    _mm256_store_ps(lanes.deltaY, deltaY);
+    _mm256_store_ps(lanes.offsetX, offsetX);
+    _mm256_store_ps(lanes.offsetY, offsetY);
+    _mm256_store_si256((__m256i *)lanes.stepX, stepX);
+    _mm256_store_si256((__m256i *)lanes.stepY, stepY);
+
+    __m256i mapX = _mm256_set1_epi32(mapPos.x);
+    __m256i mapY = _mm256_set1_epi32(mapPos.y);
+    __m256i takenX = _mm256_setzero_si256();
+    __m256i takenY = _mm256_setzero_si256();
+    __m256 horizontal = zero;
+    __m256 distance = zero;
+    // lanes past count are never active
+    __m256 active = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(count), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)));
+
+    const int *solidity = (const int *)getSolidity();
+    const int chunksX = getMapChunksX();
+    const int *occupancy = (const int *)getChunkOccupancy();
+    const int occupancyChunksX = getChunkOccupancyChunksX();
+    int steps = 0;
+    while (_mm256_movemask_ps(active) && steps < max_ray_steps)
+    {
+        // rays in a chunk that is empty in the occupancy pyramid skip it, the others step.
+        // Active rays are never outside of the map, finished ones skip the gather.
+        __m256 skipMask = zero;
+        if (skipping)
+        {
+            const __m256i cellX = _mm256_srai_epi32(mapX, chunk_shift);
+            const __m256i cellY = _mm256_srai_epi32(mapY, chunk_shift);
+            const __m256i chunk = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_srai_epi32(cellY, chunk_shift), _mm256_set1_epi32(occupancyChunksX)),
+                                                   _mm256_srai_epi32(cellX, chunk_shift));
+            const __m256i bit = _mm256_add_epi32(_mm256_slli_epi32(_mm256_and_si256(cellY, _mm256_set1_epi32(chunk_mask)), chunk_shift),
+                                                 _mm256_and_si256(cellX, _mm256_set1_epi32(chunk_mask)));
+            const __m256i word = _mm256_add_epi32(_mm256_slli_epi32(chunk, 1), _mm256_srli_epi32(bit, 5));
+            const __m256i words = _mm256_mask_i32gather_epi32(_mm256_set1_epi32(-1), occupancy, word, _mm256_castps_si256(active), 4);
+            const __m256i occupied = _mm256_and_si256(_mm256_srlv_epi32(words, _mm256_and_si256(bit, _mm256_set1_epi32(31))), _mm256_set1_epi32(1));
+            skipMask = _mm256_and_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(occupied, _mm256_setzero_si256())), active);
+        }
+        const int skip = _mm256_movemask_ps(skipMask);
+        const __m256 stepping = _mm256_andnot_ps(skipMask, active);
+
+        const __m256 takeX = _mm256_cmp_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_cvtepi32_ps(takenX), offsetX), deltaX),
+                                           _mm256_mul_ps(_mm256_add_ps(_mm256_cvtepi32_ps(takenY), offsetY), deltaY), _CMP_LT_OQ);
+        const __m256 moveX = _mm256_and_ps(takeX, stepping);
+        const __m256 moveY = _mm256_andnot_ps(takeX, stepping);
+
+        takenX = _mm256_sub_epi32(takenX, _mm256_castps_si256(moveX));
+        takenY = _mm256_sub_epi32(takenY, _mm256_castps_si256(moveY));
+        mapX = _mm256_blendv_epi8(mapX, _mm256_add_epi32(mapX, stepX), _mm256_castps_si256(moveX));
+        mapY = _mm256_blendv_epi8(mapY, _mm256_add_epi32(mapY, stepY), _mm256_castps_si256(moveY));
+        horizontal = _mm256_blendv_ps(horizontal, takeX, stepping);
+
+        const __m256 distX = _mm256_div_ps(_mm256_add_ps(_mm256_sub_ps(_mm256_cvtepi32_ps(mapX), posX), halfX), dirX);
+        const __m256 distY = _mm256_div_ps(_mm256_add_ps(_mm256_sub_ps(_mm256_cvtepi32_ps(mapY), posY), halfY), dirY);
+        distance = _mm256_blendv_ps(distance, _mm256_blendv_ps(distY, distX, takeX), stepping);
+        packet.linesCrossed += __builtin_popcount(_mm256_movemask_ps(stepping));
+
+        if (skip)
+        {
+            _mm256_store_si256((__m256i *)lanes.mapX, mapX);
+            _mm256_store_si256((__m256i *)lanes.mapY, mapY);
+            _mm256_store_si256((__m256i *)lanes.takenX, takenX);
+            _mm256_store_si256((__m256i *)lanes.takenY, takenY);
+            _mm256_store_ps((float *)lanes.horizontal, horizontal);
+            _mm256_store_ps(lanes.distance, distance);
+            packet.linesCrossed += skipLanes(rayPos, packet, 0, lanes, skip);
+            mapX = _mm256_load_si256((const __m256i *)lanes.mapX);
+            mapY = _mm256_load_si256((const __m256i *)lanes.mapY);
+            takenX = _mm256_load_si256((const __m256i *)lanes.takenX);
+            takenY = _mm256_load_si256((const __m256i *)lanes.takenY);
+            horizontal = _mm256_load_ps((const float *)lanes.horizontal);
+            distance = _mm256_load_ps(lanes.distance);
+        }
+
+        ++steps;
+
+        // gather the solidity bits, finished lanes still point at their wall. Every chunk is two 32 bit
+        // words, lanes outside of the map skip the gather and are solid.
+        const __m256i inside = _mm256_and_si256(
+            _mm256_and_si256(_mm256_cmpgt_epi32(mapX, _mm256_set1_epi32(-1)), _mm256_cmpgt_epi32(_mm256_set1_epi32(mapWidth), mapX)),
+            _mm256_and_si256(_mm256_cmpgt_epi32(mapY, _mm256_set1_epi32(-1)), _mm256_cmpgt_epi32(_mm256_set1_epi32(mapHeight), mapY)));
+        const __m256i chunk = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_srai_epi32(mapY, chunk_shift), _mm256_set1_epi32(chunksX)),
+                                               _mm256_srai_epi32(mapX, chunk_shift));
+        const __m256i bit = _mm256_add_epi32(_mm256_slli_epi32(_mm256_and_si256(mapY, _mm256_set1_epi32(chunk_mask)), chunk_shift),
+                                             _mm256_and_si256(mapX, _mm256_set1_epi32(chunk_mask)));
+        const __m256i word = _mm256_add_epi32(_mm256_slli_epi32(chunk, 1), _mm256_srli_epi32(bit, 5));
+        const __m256i words = _mm256_mask_i32gather_epi32(_mm256_set1_epi32(-1), solidity, word, inside, 4);
+        const __m256i solid = _mm256_and_si256(_mm256_srlv_epi32(words, _mm256_and_si256(bit, _mm256_set1_epi32(31))), _mm256_set1_epi32(1));
+        const __m256 hitMask = _mm256_and_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(solid, _mm256_set1_epi32(1))), active);
+        int hit = _mm256_movemask_ps(hitMask);
+        while (hit)
+        {
+            packet.steps[__builtin_ctz(hit)] = steps;
+            packet.stepsTaken += steps;
+            hit &= hit - 1;
+        }
+        active = _mm256_andnot_ps(hitMask, active);
+    }
+
+    // calculate where the wall was hit and the x coordinate on the wall texture
+    __m256 wall_x = _mm256_blendv_ps(_mm256_add_ps(posX, _mm256_mul_ps(distance, dirX)), _mm256_add_ps(posY, _mm256_mul_ps(distance, dirY)), horizontal);
+    wall_x = _mm256_sub_ps(wall_x, _mm256_floor_ps(wall_x));
+    __m256i tex_x = _mm256_cvttps_epi32(_mm256_mul_ps(wall_x, _mm256_set1_ps(float(texture_wall_size))));
+    // flip texture if we see it on the other side of us
+    const __m256 flip = _mm256_or_ps(_mm256_and_ps(horizontal, _mm256_cmp_ps(dirX, zero, _CMP_LE_OQ)),
+                                     _mm256_andnot_ps(horizontal, _mm256_cmp_ps(dirY, zero, _CMP_GE_OQ)));
+    tex_x = _mm256_blendv_epi8(tex_x, _mm256_sub_epi32(_mm256_set1_epi32(texture_wall_size - 1), tex_x), _mm256_castps_si256(flip));
+
+    _mm256_store_si256((__m256i *)packet.mapX, mapX);
+    _mm256_store_si256((__m256i *)packet.mapY, mapY);
+    for (int i = 0; i < count; ++i)
+    {
+        packet.tile[i] = getTile(packet.mapX[i], packet.mapY[i]);
+    }
+    _mm256_store_ps(packet.distance, distance);
+    _mm256_store_ps(packet.wall_x, wall_x);
+    _mm256_store_si256((__m256i *)packet.tex_x, tex_x);
+    const int horizontalBits = _mm256_movemask_ps(horizontal);
+    for (int i = 0; i < 8; ++i)
+    {
+        packet.horizontal[i] = horizontalBits & (1 << i);
+    }
+}
+
+#endif
+
+void castRays(sf::Vector2f rayPos, RayPacket &packet, int count)
+{
+#ifdef RAYCAST_X86
+    if (simd == RaycastSimd::AVX2)
+    {
+        castRaysAVX2(rayPos, packet, count);
+        return;
+    }
+    if (simd == RaycastSimd::SSE41)
+    {
+        castRaysSSE41(rayPos, packet, 0, std::min(count, 4));
+        if (count > 4)
+        {
+            castRaysSSE41(rayPos, packet, 4, count - 4);
+        }
+        return;
+    }
+#endif
+    castRaysScalar(rayPos, packet, count);
+}
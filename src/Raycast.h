@@ -0,0 +1,66 @@
+#ifndef Raycast_hpp
+#define Raycast_hpp
+#include <SFML/Graphics.hpp>
+#include "Map.h"
+
+// maximal number of grid lines a ray can cross before it reaches the edge of the map
+int getMaxRaySteps();
+
+// instruction set used to march ray packets
+enum class RaycastSimd
+{
+    Scalar,
+    SSE41,
+    AVX2
+};
+
+// rays cast from the same position, traversed together. Adjacent screen columns go into one packet.
+struct RayPacket
+{
+    static const int size = 8;
+
+    // input: direction of each ray
+    alignas(32) float dirX[size];
+    alignas(32) float dirY[size];
+
+    // output: tile that was hit and its type
+    alignas(32) int mapX[size];
+    alignas(32) int mapY[size];
+    char tile[size];
+    // did the ray hit a horizontal side? Otherwise it's vertical
+    bool horizontal[size];
+    // wall distance, projected on camera direction
+    alignas(32) float distance[size];
+    // where the wall was hit, between 0 and 1
+    alignas(32) float wall_x[size];
+    // x coordinate on the wall texture
+    alignas(32) int tex_x[size];
+    // number of DDA steps taken, the last one is the wall. A step crosses one grid line, or a whole
+    // empty block of the occupancy pyramid.
+    int steps[size];
+
+    // statistics, summed up over all casts until the caller resets them:
+    // DDA steps taken and grid lines crossed by them
+    long stepsTaken = 0;
+    long linesCrossed = 0;
+};
+
+// cast the first count rays of the packet from rayPos until each of them hits a wall
+void castRays(sf::Vector2f rayPos, RayPacket &packet, int count);
+
+// fill in lane i of the packet for a ray known to hit the tile at mapPos on the given side, without
+// marching it. Same results as castRays() for that ray, no steps taken.
+void hitFace(sf::Vector2f rayPos, RayPacket &packet, int i, sf::Vector2i mapPos, bool horizontal);
+
+// skip empty blocks of the occupancy pyramid, on by default
+void setEmptySpaceSkipping(bool skip);
+bool getEmptySpaceSkipping();
+
+// picks the widest instruction set the CPU supports
+RaycastSimd detectRaycastSimd();
+// force an instruction set, falls back to the detected one if the CPU doesn't support it
+void setRaycastSimd(RaycastSimd simd);
+RaycastSimd getRaycastSimd();
+const char *getRaycastSimdName(RaycastSimd simd);
+
+#endif
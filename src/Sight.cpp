@@ -0,0 +1,263 @@
+#include "Sight.h"
+#include <stdlib.h>
+#include <algorithm>
+#include <atomic>
+#include <vector>
+#include "Dda.h"
+#include "Engine.h"
+#include "Map.h"
+#include "Raycast.h"
+#include "ThreadPool.h"
+
+// sets of the tiles of a map chunk, row by row
+struct ChunkSight
+{
+    // rows of the square around every tile that have a tile in sight, bit y for row y
+    uint32_t rows[chunk_size * chunk_size];
+    // where the words of the rows of every tile start, the words of the last one end at words.size()
+    uint32_t first[chunk_size * chunk_size];
+    // bit x of a word is the tile x - sight_radius across from the tile, the row y - sight_radius down
+    std::vector<uint32_t> words;
+};
+
+static std::vector<ChunkSight> pages;
+static std::vector<int> freePages;
+// page of every map chunk, -1 for chunks without sets
+static std::vector<int> chunkPages;
+static int chunksX = 0;
+static int chunksY = 0;
+// map version the sets are up to date with, they aren't used at any other
+static uint32_t sightVersion = 0;
+// chunks that get pages in buildSight()
+static std::vector<sf::Vector2i> building;
+static std::vector<int> buildingPages;
+
+static sf::Vector2f getMiddle(sf::Vector2i tile)
+{
+    return sf::Vector2f(tile.x + 0.5f, tile.y + 0.5f);
+}
+
+bool isSegmentClear(sf::Vector2f from, sf::Vector2f to)
+{
+    DdaRay ray;
+    initRay(ray, from, to - from);
+    const sf::Vector2i end((int)floorf(to.x), (int)floorf(to.y));
+    // every step crosses one of the grid lines between the tiles of the ends
+    int lines = abs(end.x - ray.mapPos.x) + abs(end.y - ray.mapPos.y);
+
+    SolidityCursor cursor;
+    cursor.isSolid(ray.mapPos.x, ray.mapPos.y);
+    while (lines > 0)
+    {
+        int block_x, block_y;
+        int size = getEmptySpaceSkipping() && cursor.isChunkEmpty() ? getEmptyBlock(ray.mapPos.x, ray.mapPos.y, block_x, block_y) : 0;
+        if (size)
+        {
+            // nothing is in the way of an end in the same empty block
+            if (end.x >= block_x && end.y >= block_y && end.x < block_x + size && end.y < block_y + size)
+            {
+                return true;
+            }
+            lines -= skipBlock(ray, block_x, block_y, size);
+        }
+        else
+        {
+            stepRay(ray);
+            --lines;
+        }
+        if (lines > 0 && cursor.isSolid(ray.mapPos.x, ray.mapPos.y))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// from the sets: 1 if tile from can see tile to, 0 if it can't, -1 if they don't know
+static int lookUp(sf::Vector2i from, sf::Vector2i to)
+{
+    const int column = to.x - from.x + sight_radius;
+    const int row = to.y - from.y + sight_radius;
+    if (sightVersion != getMapVersion() || (unsigned)column >= (unsigned)sight_size || (unsigned)row >= (unsigned)sight_size ||
+        from.x < 0 || from.y < 0 || (from.x >> chunk_shift) >= chunksX || (from.y >> chunk_shift) >= chunksY)
+    {
+        return -1;
+    }
+    const int page = chunkPages[(size_t)(from.y >> chunk_shift) * chunksX + (from.x >> chunk_shift)];
+    if (page < 0)
+    {
+        return -1;
+    }
+    const ChunkSight &sight = pages[page];
+    const int tile = (from.y & chunk_mask) * chunk_size + (from.x & chunk_mask);
+    const uint32_t rows = sight.rows[tile];
+    if (!((rows >> row) & 1))
+    {
+        return 0;
+    }
+    const uint32_t word = sight.words[sight.first[tile] + __builtin_popcount(rows & ((1u << row) - 1))];
+    return (word >> column) & 1;
+}
+
+bool canSee(sf::Vector2i from, sf::Vector2i to)
+{
+    int known = lookUp(from, to);
+    return known >= 0 ? known : isSegmentClear(getMiddle(from), getMiddle(to));
+}
+
+int querySight(const SightQuery *queries, int count, uint8_t *visible)
+{
+    std::atomic<int> looked{0};
+    getRenderPool().run((count + sight_batch - 1) / sight_batch, [&](int task) {
+        int end = std::min((task + 1) * sight_batch, count);
+        int found = 0;
+        for (int i = task * sight_batch; i < end; ++i)
+        {
+            int known = lookUp(queries[i].from, queries[i].to);
+            if (known >= 0)
+            {
+                visible[i] = known;
+                ++found;
+            }
+            else
+            {
+                visible[i] = isSegmentClear(getMiddle(queries[i].from), getMiddle(queries[i].to));
+            }
+        }
+        looked += found;
+    });
+    return looked;
+}
+
+// cast from every tile of the chunk to every tile of the square around it
+static void buildChunk(ChunkSight &sight, sf::Vector2i chunk)
+{
+    sight.words.clear();
+    for (int tile = 0; tile < chunk_size * chunk_size; ++tile)
+    {
+        sf::Vector2i from(chunk.x * chunk_size + (tile & chunk_mask), chunk.y * chunk_size + (tile >> chunk_shift));
+        sight.rows[tile] = 0;
+        sight.first[tile] = sight.words.size();
+        for (int row = 0; row < sight_size; ++row)
+        {
+            uint32_t word = 0;
+            for (int column = 0; column < sight_size; ++column)
+            {
+                sf::Vector2i to(from.x + column - sight_radius, from.y + row - sight_radius);
+                if (isSegmentClear(getMiddle(from), getMiddle(to)))
+                {
+                    word |= 1u << column;
+                }
+            }
+            if (word)
+            {
+                sight.rows[tile] |= 1u << row;
+                sight.words.push_back(word);
+            }
+        }
+    }
+}
+
+static void dropChunk(int chunk_x, int chunk_y)
+{
+    int &page = chunkPages[(size_t)chunk_y * chunksX + chunk_x];
+    if (page >= 0)
+    {
+        freePages.push_back(page);
+        page = -1;
+    }
+}
+
+// tiles set on the map drop the sets of the chunks that have them in their squares
+static void dropChanged(void *, const MapRect *rects, int count)
+{
+    // a change that wasn't published came in between, none of the sets can be trusted
+    if (sightVersion + 1 != getMapVersion())
+    {
+        clearSight();
+        return;
+    }
+    sightVersion = getMapVersion();
+    for (int i = 0; i < count; ++i)
+    {
+        const MapRect &rect = rects[i];
+        int x0 = std::max((rect.x0 - sight_radius) >> chunk_shift, 0);
+        int y0 = std::max((rect.y0 - sight_radius) >> chunk_shift, 0);
+        int x1 = std::min((rect.x1 + sight_radius) >> chunk_shift, chunksX - 1);
+        int y1 = std::min((rect.y1 + sight_radius) >> chunk_shift, chunksY - 1);
+        for (int y = y0; y <= y1; ++y)
+        {
+            for (int x = x0; x <= x1; ++x)
+            {
+                dropChunk(x, y);
+            }
+        }
+    }
+}
+
+void clearSight()
+{
+    addMapListener(dropChanged, NULL);
+    chunksX = getMapChunksX();
+    chunksY = (getMapHeight() + chunk_mask) / chunk_size;
+    chunkPages.assign((size_t)chunksX * chunksY, -1);
+    freePages.clear();
+    for (int page = pages.size() - 1; page >= 0; --page)
+    {
+        freePages.push_back(page);
+    }
+    sightVersion = getMapVersion();
+}
+
+void buildSight(sf::Vector2i tile, int radius)
+{
+    if (sightVersion != getMapVersion() || chunkPages.empty())
+    {
+        clearSight();
+    }
+    building.clear();
+    buildingPages.clear();
+    const sf::Vector2i center(tile.x >> chunk_shift, tile.y >> chunk_shift);
+    for (int y = std::max(center.y - radius, 0); y <= std::min(center.y + radius, chunksY - 1); ++y)
+    {
+        for (int x = std::max(center.x - radius, 0); x <= std::min(center.x + radius, chunksX - 1); ++x)
+        {
+            int &page = chunkPages[(size_t)y * chunksX + x];
+            if (page >= 0)
+            {
+                continue;
+            }
+            if (freePages.empty())
+            {
+                page = pages.size();
+                pages.emplace_back();
+            }
+            else
+            {
+                page = freePages.back();
+                freePages.pop_back();
+            }
+            building.push_back(sf::Vector2i(x, y));
+            buildingPages.push_back(page);
+        }
+    }
+    getRenderPool().run(building.size(), [](int i) { buildChunk(pages[buildingPages[i]], building[i]); });
+}
+
+int getSightChunks()
+{
+    return pages.size() - freePages.size();
+}
+
+size_t getSightBytes()
+{
+    size_t bytes = 0;
+    for (int page : chunkPages)
+    {
+        if (page >= 0)
+        {
+            bytes += sizeof(ChunkSight) + pages[page].words.size() * sizeof(uint32_t);
+        }
+    }
+    return bytes;
+}
@@ -0,0 +1,45 @@
+#ifndef Sight_hpp
+#define Sight_hpp
+#include <stdint.h>
+#include <SFML/Graphics.hpp>
+
+// Line of sight over the map, along the same grid traversal as the rays. Sight between tiles goes from
+// the middle of one to the middle of the other and can be looked up in a potentially visible set: for
+// every tile, the tiles up to sight_radius away it can see, built chunk by chunk with buildSight().
+// Tiles set on the map drop the sets of the chunks in sight of them, sight from there is cast again
+// until they are built anew. Sight farther than sight_radius is always cast.
+//
+// A set is stored per tile as the rows of the square around it that aren't empty: a mask of those rows
+// and one 32 bit word for each of them, so a lookup is a bit test, a popcount and a load.
+
+// tiles the sets reach in each direction, a row of the square fits in a word
+const int sight_radius = 15;
+const int sight_size = 2 * sight_radius + 1;
+// queries answered by one task of the render threads
+const int sight_batch = 1024;
+
+// sight from a tile to another, for querySight()
+struct SightQuery
+{
+    sf::Vector2i from;
+    sf::Vector2i to;
+};
+
+// does the segment pass only through empty tiles? The tiles of its ends don't count.
+bool isSegmentClear(sf::Vector2f from, sf::Vector2f to);
+// can the middle of tile from see the middle of tile to? From the sets where they are built.
+bool canSee(sf::Vector2i from, sf::Vector2i to);
+// answer count queries on the render threads, visible[i] is 1 if query i can see and 0 if it can't
+// returns: number of queries looked up in the sets, the others were cast
+int querySight(const SightQuery *queries, int count, uint8_t *visible);
+
+// build the sets of the chunks up to radius chunks around the chunk of tile, the ones that aren't built
+// or were dropped, on the render threads
+void buildSight(sf::Vector2i tile, int radius);
+// drop all sets, they are dropped too when the map changes without publishing it
+void clearSight();
+// chunks with sets, and the memory of their sets
+int getSightChunks();
+size_t getSightBytes();
+
+#endif
@@ -0,0 +1,106 @@
+#include "Simulation.h"
+#include <algorithm>
+#include "Doors.h"
+#include "Navigation.h"
+
+Simulation::Simulation() : previous(getPlayerState()), current(previous)
+{
+    // the ticks of the longest frame, so predicting them doesn't allocate
+    predicted.reserve((size_t)(max_frame_time * tick_rate) + 1);
+}
+
+void Simulation::setReplay(const InputLog *log)
+{
+    replay = log;
+}
+
+void Simulation::setRecording(InputLog *log)
+{
+    recording = log;
+}
+
+uint8_t Simulation::getInput(long tick, uint8_t live) const
+{
+    return replay ? replay->getInput(tick) : live;
+}
+
+void Simulation::tick(uint8_t input)
+{
+    if (recording)
+    {
+        recording->record(ticks, input);
+    }
+    handleMove(input, tick_time);
+    // doors go before the agents, so the field they follow sees the doors of this tick
+    updateDoors(tick_time);
+    updateAgents(tick_time);
+    ++ticks;
+}
+
+int Simulation::advance(float dt, uint8_t live)
+{
+    pending += std::min(dt, max_frame_time);
+    int count = 0;
+    if (pending >= tick_time || !predicted.empty())
+    {
+        // ticks move the player from where the last one left it, not from the interpolated state
+        setPlayerState(current);
+        for (uint8_t input : predicted)
+        {
+            previous = getPlayerState();
+            tick(input);
+            ++count;
+        }
+        predicted.clear();
+        for (; pending >= tick_time; pending -= tick_time, ++count)
+        {
+            previous = getPlayerState();
+            tick(getInput(ticks, live));
+        }
+        current = getPlayerState();
+    }
+    setPlayerState(interpolatePlayer(previous, current, pending / tick_time));
+    return count;
+}
+
+int Simulation::predict(float dt, uint8_t live)
+{
+    pending += std::min(dt, max_frame_time);
+    int count = 0;
+    if (pending >= tick_time)
+    {
+        setPlayerState(predicted.empty() ? current : predictedCurrent);
+        for (; pending >= tick_time; pending -= tick_time, ++count)
+        {
+            uint8_t input = getInput(ticks + predicted.size(), live);
+            predicted.push_back(input);
+            predictedPrevious = getPlayerState();
+            handleMove(input, tick_time);
+        }
+        predictedCurrent = getPlayerState();
+    }
+    if (predicted.empty())
+    {
+        setPlayerState(interpolatePlayer(previous, current, pending / tick_time));
+    }
+    else
+    {
+        setPlayerState(interpolatePlayer(predictedPrevious, predictedCurrent, pending / tick_time));
+    }
+    return count;
+}
+
+int Simulation::getPredictedTicks() const
+{
+    return predicted.size();
+}
+
+long Simulation::getTick() const
+{
+    return ticks;
+}
+
+bool Simulation::isReplayFinished() const
+{
+    return replay && ticks >= replay->getTicks();
+}
@@ -0,0 +1,60 @@
+#ifndef Simulation_hpp
+#define Simulation_hpp
+#include <vector>
+#include "Input.h"
+#include "Player.h"
+
+// the game state changes in fixed ticks, independent of the frame rate
+const int tick_rate = 60;
+const float tick_time = 1.0f / tick_rate;
+// frame time simulated at most in one frame, longer frames slow the game down instead of piling up ticks
+const float max_frame_time = 0.25f;
+
+// Runs the ticks that are due as real time passes. Between advance() calls the player is left
+// interpolated between the last two ticks by the time that is left over, so rendering moves smoothly
+// at any frame rate while the simulation stays the same.
+class Simulation
+{
+public:
+    Simulation();
+
+    // replay the input of log instead of the live input, NULL for live input
+    void setReplay(const InputLog *log);
+    // record the input of every tick into log, NULL to stop
+    void setRecording(InputLog *log);
+
+    // run the ticks due after dt more seconds, live: input held down during them. Ticks predict() ran
+    // go first, in full this time.
+    // returns: the number of ticks run
+    int advance(float dt, uint8_t live);
+    // while a frame renders from the game nothing it reads may change, but the input goes on. The ticks due
+    // after dt more seconds only read their input and move the player, from where the last tick left it.
+    // advance() runs them again with the same input, so the game ends up as if they had run in full.
+    // returns: the number of ticks predicted
+    int predict(float dt, uint8_t live);
+    // ticks predict() ran that advance() didn't run yet
+    int getPredictedTicks() const;
+    // number of ticks run so far
+    long getTick() const;
+    // has the replayed log ended?
+    bool isReplayFinished() const;
+
+private:
+    uint8_t getInput(long tick, uint8_t live) const;
+    void tick(uint8_t input);
+
+    const InputLog *replay = nullptr;
+    InputLog *recording = nullptr;
+    long ticks = 0;
+    // simulated time not yet made a tick
+    float pending = 0.0f;
+    // the player after the last two ticks
+    PlayerState previous;
+    PlayerState current;
+    // input of the ticks predict() ran, and the player after the last two of them
+    std::vector<uint8_t> predicted;
+    PlayerState predictedPrevious;
+    PlayerState predictedCurrent;
+};
+
+#endif
@@ -0,0 +1,249 @@
+#include "Sprites.h"
+#include <math.h>
+#include <algorithm>
+#include <vector>
+#include "Engine.h"
+#include "Entities.h"
+
+// sprites closer than this are left out, they would cover the screen many times over
+const float sprite_near = 0.1f;
+
+// sprite in view, placed on the screen
+struct VisibleSprite
+{
+    float depth; // distance projected on the camera direction, like the wall depth
+    int left;    // first screen column, can be off screen
+    int size;    // width and height in pixels
+    int draw_start;
+    int draw_end;
+    int texture_x; // left edge of the sprite in the sprite texture
+    sf::Color color;
+};
+
+static std::vector<VisibleSprite> visible;
+// farthest wall in every slice of render_slice_width screen columns
+static std::vector<float> sliceDepth;
+
+// normal of a frustum edge along edge, pointing to the side inside
+static sf::Vector2f getInsideNormal(sf::Vector2f edge, sf::Vector2f inside)
+{
+    sf::Vector2f normal(-edge.y, edge.x);
+    if (normal.x * inside.x + normal.y * inside.y < 0)
+    {
+        normal = -normal;
+    }
+    return normal / sqrtf(normal.x * normal.x + normal.y * normal.y);
+}
+
+static float dot(sf::Vector2f a, sf::Vector2f b)
+{
+    return a.x * b.x + a.y * b.y;
+}
+
+// place an entity on the screen, false if it's out of view or hidden behind the walls
+static bool placeSprite(const Entity &entity, sf::Vector2f position, sf::Vector2f direction, sf::Vector2f plane,
+                        float inverse_determinant, const float *depth, VisibleSprite &sprite)
+{
+    // entity in camera space: x across the screen, y the depth
+    sf::Vector2f offset = entity.position - position;
+    float camera_x = inverse_determinant * (direction.y * offset.x - direction.x * offset.y);
+    float camera_y = inverse_determinant * (-plane.y * offset.x + plane.x * offset.y);
+    if (camera_y < sprite_near)
+    {
+        return false;
+    }
+
+    // one tile wide and high, standing on the floor like the walls
+    const int screenWidth = getScreenWidth();
+    const int screenHeight = getScreenHeight();
+    int size = (int)(screenHeight / camera_y);
+    int center = (int)(screenWidth / 2 * (1.0f + camera_x / camera_y));
+    int left = center - size / 2;
+    int first = std::max(left, 0);
+    int end = std::min(left + size, screenWidth);
+    if (size <= 0 || first >= end)
+    {
+        return false;
+    }
+    // is there a column it's in front of the wall in?
+    int x = first;
+    while (x < end && depth[x] <= camera_y)
+    {
+        ++x;
+    }
+    if (x == end)
+    {
+        return false;
+    }
+
+    // darker on distance, as the walls
+    sf::Color color = sf::Color::White;
+    int shade = (int)std::min(camera_y * 40, 255.0f);
+    color.r -= shade;
+    color.g -= shade;
+    color.b -= shade;
+
+    sprite = VisibleSprite{camera_y,
+                           left,
+                           size,
+                           int(-size * (1.0f - cameraHeight) + screenHeight * 0.5f),
+                           int(size * cameraHeight + screenHeight * 0.5f),
+                           (int)entity.sprite * sprite_size,
+                           color};
+    return true;
+}
+
+// is a circle around a cell, offset from the camera, behind the walls of all the screen slices it covers?
+// radius: of the circle in camera space, whose axes are scaled by the length of the plane and the direction
+static bool isCellHidden(sf::Vector2f offset, sf::Vector2f radius, sf::Vector2f direction, sf::Vector2f plane,
+                         float inverse_determinant)
+{
+    float camera_x = inverse_determinant * (direction.y * offset.x - direction.x * offset.y);
+    float camera_y = inverse_determinant * (-plane.y * offset.x + plane.x * offset.y);
+    float radius_x = radius.x;
+    float radius_y = radius.y;
+    float nearest = camera_y - radius_y;
+    if (nearest < sprite_near)
+    {
+        return false;
+    }
+
+    // screen columns it can cover, from the corners of its box in camera space
+    float left = std::min((camera_x - radius_x) / nearest, (camera_x - radius_x) / (camera_y + radius_y));
+    float right = std::max((camera_x + radius_x) / nearest, (camera_x + radius_x) / (camera_y + radius_y));
+    const int screenWidth = getScreenWidth();
+    int first = std::max((int)(screenWidth / 2 * (1.0f + left)), 0);
+    int last = std::min((int)(screenWidth / 2 * (1.0f + right)), screenWidth - 1);
+    for (int slice = first / render_slice_width; slice <= last / render_slice_width; ++slice)
+    {
+        if (sliceDepth[slice] > nearest)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// widen min_x - max_x to the part of segment a - b between top and bottom
+static void addRowSpan(sf::Vector2f a, sf::Vector2f b, float top, float bottom, float &min_x, float &max_x)
+{
+    if (a.y > b.y)
+    {
+        std::swap(a, b);
+    }
+    if (b.y < top || a.y > bottom)
+    {
+        return;
+    }
+    float slope = b.y > a.y ? (b.x - a.x) / (b.y - a.y) : 0.0f;
+    float start = a.y < top ? a.x + slope * (top - a.y) : a.x;
+    float end = b.y > bottom ? a.x + slope * (bottom - a.y) : b.x;
+    min_x = std::min({min_x, start, end});
+    max_x = std::max({max_x, start, end});
+}
+
+void cullSprites(sf::Vector2f position, sf::Vector2f direction, sf::Vector2f plane, const float *depth)
+{
+    visible.clear();
+    visible.reserve(getEntityCount());
+    if (getEntityCount() == 0)
+    {
+        return;
+    }
+
+    // nothing behind the farthest wall can be seen
+    const int screenWidth = getScreenWidth();
+    sliceDepth.resize((screenWidth + render_slice_width - 1) / render_slice_width);
+    float max_depth = 0.0f;
+    for (int x = 0; x < screenWidth; x += render_slice_width)
+    {
+        float &slice = sliceDepth[x / render_slice_width];
+        slice = *std::max_element(depth + x, depth + std::min(x + render_slice_width, screenWidth));
+        max_depth = std::max(max_depth, slice);
+    }
+    // view frustum: between the edge rays of the screen, in front of the camera and up to max_depth
+    sf::Vector2f left_edge = direction - plane;
+    sf::Vector2f right_edge = direction + plane;
+    sf::Vector2f left_normal = getInsideNormal(left_edge, right_edge);
+    sf::Vector2f right_normal = getInsideNormal(right_edge, left_edge);
+    sf::Vector2f far_left = position + left_edge * max_depth;
+    sf::Vector2f far_right = position + right_edge * max_depth;
+
+    // rows of cells touching the frustum, half a tile more for the width of the sprites
+    const float margin = 0.5f;
+    int y0 = std::max((int)floorf(std::min({position.y, far_left.y, far_right.y}) - margin) >> entity_cell_shift, 0);
+    int y1 = std::min((int)floorf(std::max({position.y, far_left.y, far_right.y}) + margin) >> entity_cell_shift,
+                      getEntityCellsY() - 1);
+
+    // a cell is left out when its bounding circle, grown by half a sprite, is outside of one frustum plane
+    // or behind the walls
+    const float radius = entity_cell_size * 0.7072f + margin;
+    sf::Vector2f camera_radius(radius / sqrtf(dot(plane, plane)), radius / sqrtf(dot(direction, direction)));
+    float inverse_determinant = 1.0f / (plane.x * direction.y - direction.x * plane.y);
+    for (int cell_y = y0; cell_y <= y1; ++cell_y)
+    {
+        // cells of the row touching the frustum triangle
+        float top = cell_y * entity_cell_size - margin;
+        float bottom = (cell_y + 1) * entity_cell_size + margin;
+        float min_x = INFINITY;
+        float max_x = -INFINITY;
+        addRowSpan(position, far_left, top, bottom, min_x, max_x);
+        addRowSpan(far_left, far_right, top, bottom, min_x, max_x);
+        addRowSpan(far_right, position, top, bottom, min_x, max_x);
+        if (min_x > max_x)
+        {
+            continue;
+        }
+        int x0 = std::max((int)floorf(min_x - margin) >> entity_cell_shift, 0);
+        int x1 = std::min((int)floorf(max_x + margin) >> entity_cell_shift, getEntityCellsX() - 1);
+        for (int cell_x = x0; cell_x <= x1; ++cell_x)
+        {
+            int id = getCellEntity(cell_x, cell_y);
+            if (id < 0)
+            {
+                continue;
+            }
+            sf::Vector2f center = sf::Vector2f((cell_x + 0.5f) * entity_cell_size, (cell_y + 0.5f) * entity_cell_size) - position;
+            float forward = dot(direction, center);
+            if (forward < -radius || forward > max_depth + radius || dot(left_normal, center) < -radius ||
+                dot(right_normal, center) < -radius || isCellHidden(center, camera_radius, direction, plane, inverse_determinant))
+            {
+                continue;
+            }
+            for (; id >= 0; id = getNextEntity(id))
+            {
+                VisibleSprite sprite;
+                if (placeSprite(getEntity(id), position, direction, plane, inverse_determinant, depth, sprite))
+                {
+                    visible.push_back(sprite);
+                }
+            }
+        }
+    }
+
+    // back to front, closer sprites are drawn over farther ones
+    std::sort(visible.begin(), visible.end(),
+              [](const VisibleSprite &a, const VisibleSprite &b) { return a.depth > b.depth; });
+}
+
+void renderSprites(RenderBackend &backend, int first, int end, const float *depth)
+{
+    for (const VisibleSprite &sprite : visible)
+    {
+        int x_end = std::min(sprite.left + sprite.size, end);
+        for (int x = std::max(sprite.left, first); x < x_end; ++x)
+        {
+            // only where the sprite is in front of the wall
+            if (sprite.depth < depth[x])
+            {
+                int texture_x = sprite.texture_x + (x - sprite.left) * sprite_size / sprite.size;
+                backend.spriteSpan(x, sprite.draw_start, sprite.draw_end, sf::Vector2i(texture_x, 0), sprite.color);
+            }
+        }
+    }
+}
+
+int getVisibleSprites()
+{
+    return visible.size();
+}
@@ -0,0 +1,18 @@
+#ifndef Sprites_hpp
+#define Sprites_hpp
+#include <SFML/Graphics.hpp>
+#include "Backend.h"
+
+// Sprite pass of render(), run after the walls. The entities in view are found through the cells of the
+// entity grid that touch the view frustum, sorted back to front and drawn as columns clipped by the
+// depth of the wall in each column.
+
+// find the sprites in view that aren't completely behind walls, farthest first.
+// depth: distance of the wall in every screen column
+void cullSprites(sf::Vector2f position, sf::Vector2f direction, sf::Vector2f plane, const float *depth);
+// draw screen columns first to end - 1 of the sprites found by the last cullSprites()
+void renderSprites(RenderBackend &backend, int first, int end, const float *depth);
+// number of sprites found by the last cullSprites()
+int getVisibleSprites();
+
+#endif
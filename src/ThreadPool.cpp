@@ -0,0 +1,90 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(int threads)
+{
+    for (int i = 1; i < threads; ++i)
+    {
+        workers.emplace_back(&ThreadPool::work, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    wake.notify_all();
+    for (std::thread &worker : workers)
+    {
+        worker.join();
+    }
+}
+
+int ThreadPool::size() const
+{
+    return (int)workers.size() + 1;
+}
+
+void ThreadPool::runTasks(int count, void (*task_call)(const void *, int), const void *task)
+{
+    if (workers.empty() || count <= 1)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            task_call(task, i);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        call = task_call;
+        job = task;
+        tasks = count;
+        next = 0;
+        busy = (int)workers.size();
+        ++generation;
+    }
+    wake.notify_all();
+
+    // the calling thread works too
+    takeTasks();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [this] { return busy == 0; });
+    job = nullptr;
+}
+
+void ThreadPool::work()
+{
+    unsigned seen = 0;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this, seen] { return quit || generation != seen; });
+            if (quit)
+            {
+                return;
+            }
+            seen = generation;
+        }
+
+        takeTasks();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--busy == 0)
+        {
+            finished.notify_one();
+        }
+    }
+}
+
+void ThreadPool::takeTasks()
+{
+    for (int i = next++; i < tasks; i = next++)
+    {
+        call(job, i);
+    }
+}
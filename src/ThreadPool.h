@@ -0,0 +1,50 @@
+#ifndef ThreadPool_hpp
+#define ThreadPool_hpp
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// persistent worker threads. run() hands out task indices to all workers and the calling thread,
+// workers sleep between runs, so there is no thread creation per frame
+class ThreadPool
+{
+public:
+    // threads: total number of threads doing work, including the one calling run()
+    explicit ThreadPool(int threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    int size() const;
+    // call task(i) for every i in [0, tasks) and return when all of them are done.
+    // Indices are taken from an atomic counter, so no lock is held while tasks run.
+    // The task is called through a pointer, it's never copied and nothing is allocated.
+    template <typename Task>
+    void run(int tasks, const Task &task)
+    {
+        runTasks(tasks, [](const void *task, int i) { (*(const Task *)task)(i); }, &task);
+    }
+
+private:
+    void runTasks(int tasks, void (*call)(const void *, int), const void *task);
+    void work();
+    void takeTasks();
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;     // workers wait here for a new run
+    std::condition_variable finished; // run() waits here for the workers
+    // task of the current run
+    void (*call)(const void *, int) = nullptr;
+    const void *job = nullptr;
+    int tasks = 0;
+    std::atomic<int> next{0};
+    int busy = 0;            // workers still inside the current run
+    unsigned generation = 0; // incremented on every run, wakes the workers
+    bool quit = false;
+};
+
+#endif
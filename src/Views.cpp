@@ -0,0 +1,246 @@
+#include "Views.h"
+#include <string.h>
+#include <algorithm>
+#include "Doors.h"
+#include "Engine.h"
+#include "Lightmap.h"
+#include "Raycast.h"
+#include "ThreadPool.h"
+
+// plain walls without textures, before shading
+const sf::Uint8 view_wall_gray = 160;
+
+ViewRenderer::ViewRenderer(int width, int height, unsigned outputs)
+    : width(std::max(width, 1)), height(std::max(height, 1)), outputs(outputs)
+{
+}
+
+void ViewRenderer::setWallTextures(const WallTextures *textures)
+{
+    walls = textures;
+}
+
+int ViewRenderer::getWidth() const
+{
+    return width;
+}
+
+int ViewRenderer::getHeight() const
+{
+    return height;
+}
+
+int ViewRenderer::getViewCount() const
+{
+    return views;
+}
+
+const float *ViewRenderer::getDepth(int view) const
+{
+    return (outputs & view_depth) ? &depth[(size_t)view * width] : NULL;
+}
+
+const char *ViewRenderer::getTiles(int view) const
+{
+    return (outputs & view_tiles) ? &tiles[(size_t)view * width] : NULL;
+}
+
+const uint8_t *ViewRenderer::getTextureColumns(int view) const
+{
+    return (outputs & view_texture_columns) ? &textureColumns[(size_t)view * width] : NULL;
+}
+
+const uint8_t *ViewRenderer::getImage(int view) const
+{
+    return (outputs & view_images) ? &images[(size_t)view * width * height * 4] : NULL;
+}
+
+long ViewRenderer::getRaySteps() const
+{
+    return raySteps;
+}
+
+void ViewRenderer::render(const ViewCamera *cameras, int count)
+{
+    views = count;
+    const size_t columns = (size_t)count * width;
+    if ((outputs & view_depth) && depth.size() < columns)
+    {
+        depth.resize(columns);
+    }
+    if ((outputs & view_tiles) && tiles.size() < columns)
+    {
+        tiles.resize(columns);
+    }
+    if ((outputs & view_texture_columns) && textureColumns.size() < columns)
+    {
+        textureColumns.resize(columns);
+    }
+    if (outputs & view_images)
+    {
+        if (images.size() < columns * height * 4)
+        {
+            images.resize(columns * height * 4);
+        }
+        // floor and ceiling are plain, darker on distance as the rows of render()
+        rowColors.resize(height);
+        for (int y = 0; y < height; ++y)
+        {
+            bool ceiling = y < height / 2;
+            sf::Color color = ceiling ? sf::Color::White : color_brick;
+            if (getRenderFeatures() & render_fog)
+            {
+                float distance = ceiling ? height * (1.0f - cameraHeight) / (height / 2 - (y + 0.5f))
+                                         : height * cameraHeight / (y + 0.5f - height / 2);
+                color.r /= distance;
+                color.g /= distance;
+                color.b /= distance;
+            }
+            rowColors[y] = color;
+        }
+    }
+
+    const int views_per_task = std::max(1, view_task_rays / width);
+    raySteps = 0;
+    getRenderPool().run((count + views_per_task - 1) / views_per_task, [&](int task) {
+        long steps = 0;
+        int end = std::min((task + 1) * views_per_task, count);
+        for (int view = task * views_per_task; view < end; ++view)
+        {
+            renderView(cameras[view], view, steps);
+        }
+        raySteps += steps;
+    });
+}
+
+void ViewRenderer::renderView(const ViewCamera &camera, int view, long &steps)
+{
+    RayPacket packet;
+    const size_t offset = (size_t)view * width;
+    uint8_t *image = (outputs & view_images) ? &images[offset * height * 4] : NULL;
+    for (int first = 0; first < width; first += RayPacket::size)
+    {
+        int count = std::min(RayPacket::size, width - first);
+        for (int i = 0; i < count; ++i)
+        {
+            // through the left edge of the column, as render() with a ray per column
+            float cameraX = 2 * (first + i) / (float)width - 1.0f;
+            packet.dirX[i] = camera.direction.x + camera.plane.x * cameraX;
+            packet.dirY[i] = camera.direction.y + camera.plane.y * cameraX;
+        }
+        castRays(camera.position, packet, count);
+        for (int i = 0; i < count; ++i)
+        {
+            size_t column = offset + first + i;
+            if (outputs & view_depth)
+            {
+                depth[column] = packet.distance[i];
+            }
+            if (outputs & view_tiles)
+            {
+                tiles[column] = packet.tile[i];
+            }
+            if (outputs & view_texture_columns)
+            {
+                textureColumns[column] = packet.tex_x[i];
+            }
+            if (image)
+            {
+                drawColumn(image, first + i, packet.tile[i], sf::Vector2i(packet.mapX[i], packet.mapY[i]),
+                           packet.horizontal[i], sf::Vector2f(packet.dirX[i], packet.dirY[i]), packet.distance[i],
+                           packet.wall_x[i], packet.tex_x[i]);
+            }
+        }
+    }
+    steps += packet.stepsTaken;
+}
+
+// column x of an image: ceiling, the wall shaded as render() does, floor
+void ViewRenderer::drawColumn(uint8_t *image, int x, char tile, sf::Vector2i mapPos, bool horizontal, sf::Vector2f rayDir,
+                              float distance, float wall_x, int tex_x) const
+{
+    const unsigned features = getRenderFeatures();
+    int wallHeight = height / distance;
+    int drawStart = int(-wallHeight * (1.0f - cameraHeight) + height * 0.5f);
+    int drawEnd = int(wallHeight * cameraHeight + height * 0.5f);
+
+    int level = 255;
+    if (features & render_shading)
+    {
+        level = horizontal ? (int)(255 / 1.2) : 255;
+    }
+    if (features & render_fog)
+    {
+        float fogged = level - (distance * 40);
+        level = fogged > 0 ? (int)fogged : 0;
+    }
+    sf::Color color(level, level, level);
+    if ((features & render_lighting) && distance > 1)
+    {
+        WallFace face = horizontal ? (rayDir.x > 0 ? WallFace::West : WallFace::East)
+                                   : (rayDir.y > 0 ? WallFace::North : WallFace::South);
+        FaceLight light = getFaceLight(mapPos.x, mapPos.y, face);
+        float glow = light.base + light.slope * wall_x;
+        color.r = (sf::Uint8)(int)(level + (distance * 6 * glow));
+        color.g = (sf::Uint8)(int)(level + (distance * 5 * glow));
+        color.b = (sf::Uint8)(int)(level + (distance * 3 * glow));
+    }
+    // doors slide aside over a dark doorway, as in render()
+    if (getTileAttributes(tile) & tile_door)
+    {
+        int slide = (int)(getDoorOpening(mapPos.x, mapPos.y) * texture_wall_size);
+        if (tex_x < slide)
+        {
+            color = sf::Color::Black;
+        }
+        tex_x -= tex_x < slide ? 0 : slide;
+    }
+
+    const int top = std::max(drawStart, 0);
+    const int bottom = std::min(drawEnd, height);
+    uint8_t *pixel = &image[x * 4];
+    const int stride = width * 4;
+    for (int y = 0; y < top; ++y, pixel += stride)
+    {
+        const sf::Color &row = rowColors[y];
+        pixel[0] = row.r;
+        pixel[1] = row.g;
+        pixel[2] = row.b;
+        pixel[3] = 255;
+    }
+
+    // the column of the wall texture at about one texel per pixel, rows stepped as by the framebuffer
+    const int span = drawEnd - drawStart;
+    const uint32_t *column = NULL;
+    int texture_level = 0;
+    int64_t row = 0;
+    int64_t step = 0;
+    if (walls && span > 0)
+    {
+        texture_level = WallTextures::getLevel(span);
+        column = walls->getColumn((int)getWallTexture(tile), texture_level, tex_x >> texture_level);
+        step = ((int64_t)(texture_wall_size - 2) << 16) / span;
+        row = ((int64_t)1 << 16) + step * (top - drawStart) + step / 2;
+    }
+    for (int y = top; y < bottom; ++y, pixel += stride, row += step)
+    {
+        sf::Uint8 texel[4] = {view_wall_gray, view_wall_gray, view_wall_gray, 255};
+        if (column)
+        {
+            memcpy(texel, &column[(row >> 16) >> texture_level], 4);
+        }
+        pixel[0] = texel[0] * color.r / 255;
+        pixel[1] = texel[1] * color.g / 255;
+        pixel[2] = texel[2] * color.b / 255;
+        pixel[3] = 255;
+    }
+
+    for (int y = bottom; y < height; ++y, pixel += stride)
+    {
+        const sf::Color &row = rowColors[y];
+        pixel[0] = row.r;
+        pixel[1] = row.g;
+        pixel[2] = row.b;
+        pixel[3] = 255;
+    }
+}
@@ -0,0 +1,72 @@
+#ifndef Views_hpp
+#define Views_hpp
+#include <stdint.h>
+#include <SFML/Graphics.hpp>
+#include <atomic>
+#include <vector>
+#include "WallTextures.h"
+
+// First person views of many cameras at once, for agents that see the map on their own, without a window
+// and without the player. The views are small, a ray per column, and are rendered in batches of
+// view_task_rays rays on the render threads, each view by one thread. They read the map, its occupancy
+// and light in place, every view only writes its own part of the outputs.
+
+// camera of a view, as the one of the player
+struct ViewCamera
+{
+    sf::Vector2f position;
+    sf::Vector2f direction;
+    sf::Vector2f plane; // the field of view, cameraPlane long for the one of the player
+};
+
+// outputs of a ViewRenderer, bits of its outputs
+const unsigned view_depth = 1 << 0;           // wall distance of every column, projected on the direction
+const unsigned view_tiles = 1 << 1;           // tile hit by every column
+const unsigned view_texture_columns = 1 << 2; // x on the wall texture of every column
+const unsigned view_images = 1 << 3;          // RGBA pixels, row by row
+// rays cast by one task of the render threads at least, whole views of them
+const int view_task_rays = 1024;
+
+class ViewRenderer
+{
+public:
+    // views of width columns, images of height rows, with the outputs of the given bits
+    ViewRenderer(int width, int height, unsigned outputs);
+    // walls of the images are sampled from these, which have to stay around. Without, they are plain.
+    void setWallTextures(const WallTextures *textures);
+
+    // render a view for each of count cameras. The outputs stay until the next call, memory only grows
+    // when there are more views than before.
+    void render(const ViewCamera *cameras, int count);
+
+    int getWidth() const;
+    int getHeight() const;
+    int getViewCount() const;
+    // outputs of a view of the last render(), NULL for the ones that weren't asked for
+    const float *getDepth(int view) const;
+    const char *getTiles(int view) const;
+    const uint8_t *getTextureColumns(int view) const;
+    const uint8_t *getImage(int view) const;
+    // DDA steps of all rays of the last render()
+    long getRaySteps() const;
+
+private:
+    void renderView(const ViewCamera &camera, int view, long &steps);
+    void drawColumn(uint8_t *image, int x, char tile, sf::Vector2i mapPos, bool horizontal, sf::Vector2f rayDir,
+                    float distance, float wall_x, int tex_x) const;
+
+    int width;
+    int height;
+    unsigned outputs;
+    int views = 0;
+    const WallTextures *walls = nullptr;
+    std::vector<float> depth;
+    std::vector<char> tiles;
+    std::vector<uint8_t> textureColumns;
+    std::vector<uint8_t> images;
+    // color of the floor or ceiling in every image row
+    std::vector<sf::Color> rowColors;
+    std::atomic<long> raySteps{0};
+};
+
+#endif
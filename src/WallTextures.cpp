@@ -0,0 +1,83 @@
+#include "WallTextures.h"
+#include <string.h>
+#include "Engine.h"
+
+static_assert(texture_wall_size >> (wall_mip_levels - 1) == 1, "the chain ends at 1x1");
+
+bool WallTextures::build(const sf::Image &atlas)
+{
+    if (atlas.getSize().x != (unsigned)texture_size || atlas.getSize().y != (unsigned)texture_size)
+    {
+        return false;
+    }
+    const int tiles_per_row = texture_size / texture_wall_size;
+    tileSize = texture_wall_size;
+    chainSize = 0;
+    for (int level = 0; level < wall_mip_levels; ++level)
+    {
+        levelOffset[level] = chainSize;
+        chainSize += (size_t)(tileSize >> level) * (tileSize >> level);
+    }
+    texels.assign(chainSize * tiles_per_row * tiles_per_row, 0);
+
+    const sf::Uint8 *pixels = atlas.getPixelsPtr();
+    for (int tile = 0; tile < tiles_per_row * tiles_per_row; ++tile)
+    {
+        const int left = tile % tiles_per_row * tileSize;
+        const int top = tile / tiles_per_row * tileSize;
+        uint32_t *chain = &texels[tile * chainSize];
+
+        // level 0 is the tile, transposed
+        for (int x = 0; x < tileSize; ++x)
+        {
+            for (int y = 0; y < tileSize; ++y)
+            {
+                memcpy(&chain[x * tileSize + y], &pixels[((top + y) * texture_size + left + x) * 4], 4);
+            }
+        }
+        // every other level averages 2x2 texels of the one before
+        for (int level = 1; level < wall_mip_levels; ++level)
+        {
+            const int size = tileSize >> level;
+            const uint32_t *from = &chain[levelOffset[level - 1]];
+            uint32_t *to = &chain[levelOffset[level]];
+            for (int x = 0; x < size; ++x)
+            {
+                for (int y = 0; y < size; ++y)
+                {
+                    const uint32_t *quad[4] = {&from[x * 2 * size * 2 + y * 2], &from[x * 2 * size * 2 + y * 2 + 1],
+                                               &from[(x * 2 + 1) * size * 2 + y * 2], &from[(x * 2 + 1) * size * 2 + y * 2 + 1]};
+                    sf::Uint8 average[4];
+                    for (int channel = 0; channel < 4; ++channel)
+                    {
+                        int sum = 2;
+                        for (const uint32_t *texel : quad)
+                        {
+                            sum += ((const sf::Uint8 *)texel)[channel];
+                        }
+                        average[channel] = sum / 4;
+                    }
+                    memcpy(&to[x * size + y], average, 4);
+                }
+            }
+        }
+    }
+    return true;
+}
+
+int WallTextures::getLevel(int height)
+{
+    // the span shows the tile without its first and last row, as the SFML backend does
+    const int rows = texture_wall_size - 2;
+    int level = 0;
+    while (level + 1 < wall_mip_levels && (rows >> (level + 1)) >= height)
+    {
+        ++level;
+    }
+    return level;
+}
+
+size_t WallTextures::getBytes() const
+{
+    return texels.size() * sizeof(uint32_t);
+}
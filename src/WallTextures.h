@@ -0,0 +1,41 @@
+#ifndef WallTextures_hpp
+#define WallTextures_hpp
+#include <stdint.h>
+#include <SFML/Graphics.hpp>
+#include <vector>
+
+// Wall tiles of the texture atlas prepared for sampling along screen columns. Every tile is stored
+// transposed, column after column, so the texels of a wall span are next to each other in memory, with
+// a chain of mip levels, each one half the size of the one before, down to 1x1 texel. Distant walls
+// sample a level with about one texel per pixel instead of skipping over most of the tile.
+// Texels are 32 bit RGBA, in the byte order of sf::Image.
+
+// levels of the chain, texture_wall_size down to 1
+const int wall_mip_levels = 8;
+
+class WallTextures
+{
+public:
+    // split the atlas into tiles of texture_wall_size and build their chains. False if the atlas isn't
+    // texture_size x texture_size.
+    bool build(const sf::Image &atlas);
+
+    // level for a wall span of height pixels, the smallest one that still has a texel for every pixel
+    static int getLevel(int height);
+    // column x of tile at level, with texture_wall_size >> level texels from the top down
+    const uint32_t *getColumn(int tile, int level, int x) const
+    {
+        return &texels[(size_t)tile * chainSize + levelOffset[level] + (size_t)x * (tileSize >> level)];
+    }
+    // memory of all chains
+    size_t getBytes() const;
+
+private:
+    std::vector<uint32_t> texels;
+    int tileSize = 0;
+    // texels of the chain of one tile, and where each level of it starts
+    size_t chainSize = 0;
+    size_t levelOffset[wall_mip_levels] = {};
+};
+
+#endif
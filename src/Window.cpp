@@ -1,45 +1,127 @@
 #include "Window.h"
 
-void drawLines(sf::RenderWindow &window, sf::RenderStates state)
+// tile of the full texture as a repeated texture of its own
+static bool loadTile(sf::Texture &tile, const sf::Image &texture, WallTexture type)
 {
-    // draw walls, state - textures
-    window.draw(getLines(), state);
-    // draw ceiling and flooor
-    window.draw(getFloorLines());
-    // draw player on minimap
-    window.draw(getMapLines());
+    sf::IntRect area((int)type * texture_wall_size % texture_size, (int)type * texture_wall_size / texture_size * texture_wall_size,
+                     texture_wall_size, texture_wall_size);
+    if (!tile.loadFromImage(texture, area))
+    {
+        return false;
+    }
+    tile.setRepeated(true);
+    return true;
+}
+
+SfmlBackend::SfmlBackend()
+    : RenderBackend(WindowBackend), geometry(default_screen_width, default_screen_height), frame(&geometry.getBack()),
+      width(default_screen_width), sliceWidth(default_screen_width)
+{
+}
+
+bool SfmlBackend::loadFloorTextures(const sf::Image &texture)
+{
+    return loadTile(floorTexture, texture, floor_texture) && loadTile(ceilingTexture, texture, ceiling_texture);
+}
+
+bool SfmlBackend::loadSpriteTexture(const std::string &file)
+{
+    return spriteTexture.loadFromFile(file);
 }
 
-void drawMinimap(sf::RenderWindow &window)
+void SfmlBackend::beginFrame(int frame_width, int frame_height, int slice_width)
 {
-    // draw minimap
-    sf::RectangleShape rectangle;
-    rectangle.setSize(sf::Vector2f(map_scale, map_scale));
-    for (int i = 0; i < mapHeight; i++)
+    // walls, floor rows and rays have a fixed number of vertices for the resolution, written by column or row index
+    geometry.resizeBack(frame_width, frame_height);
+    frame = &geometry.getBack();
+    width = frame_width;
+    sliceWidth = slice_width;
+    frame->sprites.resize((width + slice_width - 1) / slice_width);
+    for (std::vector<sf::Vertex> &slice : frame->sprites)
     {
-        for (int j = 0; j < mapWidth; j++)
-        {
-            rectangle.setPosition(10 + j * map_scale, 10 + i * map_scale);
-            if (getTile(j, i) != '.')
-            {
-                rectangle.setFillColor(sf::Color::Black);
-                window.draw(rectangle);
-            }
-            else
-            {
-                rectangle.setFillColor(transparent_white);
-                window.draw(rectangle);
-            }
-        }
+        slice.clear();
     }
+}
+
+void SfmlBackend::endFrame()
+{
+    geometry.swap();
+}
+
+void SfmlBackend::dropFrame()
+{
+    geometry.swap();
+}
+
+void SfmlBackend::floorRow(int y, sf::Vector2f from, sf::Vector2f to, sf::Color color)
+{
+    // texture coordinates past the edge of the repeated texture wrap around
+    frame->rows[y * 2] = sf::Vertex(sf::Vector2f(0.0f, (float)y), color, from * (float)texture_wall_size);
+    frame->rows[y * 2 + 1] = sf::Vertex(sf::Vector2f((float)width, (float)y), color, to * (float)texture_wall_size);
+}
 
-    //draw player
-    rectangle.setFillColor(sf::Color::Magenta);
-    // not very accurate values but less of math
-    rectangle.setSize(sf::Vector2f((map_scale - 3), (map_scale - 3)));
-    sf::Vector2f pos = getPosition();
-    rectangle.setPosition(10 + pos.x * (map_scale - 0.1), 10 + pos.y * (map_scale - 0.1));
-    window.draw(rectangle);
+void SfmlBackend::wallSpan(int x, int draw_start, int draw_end, sf::Vector2i texture_coords, sf::Color color)
+{
+    frame->walls[x * 2] = sf::Vertex(
+        sf::Vector2f((float)x, (float)draw_start),
+        color,
+        sf::Vector2f((float)texture_coords.x, (float)texture_coords.y + 1));
+    frame->walls[x * 2 + 1] = sf::Vertex(
+        sf::Vector2f((float)x, (float)draw_end),
+        color,
+        sf::Vector2f((float)texture_coords.x, (float)(texture_coords.y + texture_wall_size - 1)));
+}
+
+void SfmlBackend::spriteSpan(int x, int draw_start, int draw_end, sf::Vector2i texture_coords, sf::Color color)
+{
+    // transparent texels are blended away
+    std::vector<sf::Vertex> &slice = frame->sprites[x / sliceWidth];
+    slice.push_back(sf::Vertex(sf::Vector2f((float)x, (float)draw_start), color, sf::Vector2f(texture_coords)));
+    slice.push_back(sf::Vertex(sf::Vector2f((float)x, (float)draw_end), color,
+                               sf::Vector2f((float)texture_coords.x, (float)(texture_coords.y + sprite_size))));
+}
+
+void SfmlBackend::mapRay(int x, sf::Vector2f from, sf::Vector2f to)
+{
+    // in the coordinates of the minimap tiles
+    frame->rays[x * 2] = sf::Vertex(from * (float)map_scale, sf::Color::Magenta);
+    frame->rays[x * 2 + 1] = sf::Vertex(to * (float)map_scale, sf::Color::Black);
+}
+
+const FrameVertices &SfmlBackend::getFrame() const
+{
+    return geometry.getFront();
+}
+
+const sf::Texture &SfmlBackend::getFloorTexture() const
+{
+    return floorTexture;
+}
+
+const sf::Texture &SfmlBackend::getCeilingTexture() const
+{
+    return ceilingTexture;
+}
+
+const sf::Texture &SfmlBackend::getSpriteTexture() const
+{
+    return spriteTexture;
+}
+
+void drawLines(sf::RenderWindow &window, sf::RenderStates state, const SfmlBackend &backend, const FrameVertices &frame)
+{
+    // draw ceiling and flooor, walls are drawn over them. The frame can be of the resolution before.
+    const int rows = frame.rows.size() / 2;
+    const int horizon = rows / 2;
+    window.draw(&frame.rows[0], horizon * 2, sf::Lines, &backend.getCeilingTexture());
+    window.draw(&frame.rows[horizon * 2], (rows - horizon) * 2, sf::Lines, &backend.getFloorTexture());
+    // draw walls, state - textures
+    window.draw(frame.walls.data(), frame.walls.size(), sf::Lines, state);
+    // draw sprites over the walls, every slice back to front
+    for (const std::vector<sf::Vertex> &slice : frame.sprites)
+    {
+        window.draw(slice.data(), slice.size(), sf::Lines, &backend.getSpriteTexture());
+    }
 }
 
 void handleKeys()
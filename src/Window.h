@@ -2,14 +2,52 @@
 #define Window_hpp
 #include <SFML/Graphics.hpp>
 #include <iostream>
+#include <vector>
 #include "Map.h"
 #include "Engine.h"
+#include "FrameGeometry.h"
 
-// colors
-const sf::Color transparent_white(255, 255, 255, 125);
+// backend that collects the frame as SFML line lists, drawn on the window by drawLines()
+class SfmlBackend final : public RenderBackend
+{
+public:
+    SfmlBackend();
+
+    // cut the floor and ceiling textures out of the full texture, they are drawn repeated
+    bool loadFloorTextures(const sf::Image &texture);
+    // sprites side by side, sprite_size wide each
+    bool loadSpriteTexture(const std::string &file);
+
+    void beginFrame(int width, int height, int slice_width) override;
+    void floorRow(int y, sf::Vector2f from, sf::Vector2f to, sf::Color color) override;
+    void wallSpan(int x, int draw_start, int draw_end, sf::Vector2i texture_coords, sf::Color color) override;
+    void spriteSpan(int x, int draw_start, int draw_end, sf::Vector2i texture_coords, sf::Color color) override;
+    void mapRay(int x, sf::Vector2f from, sf::Vector2f to) override;
+    void endFrame() override;
+
+    // the last frame finished by render()
+    const FrameVertices &getFrame() const;
+    // throw the last finished frame away, the one before is the last one again and the next frame is
+    // written over the one thrown away. Not while a frame renders.
+    void dropFrame();
+    const sf::Texture &getFloorTexture() const;
+    const sf::Texture &getCeilingTexture() const;
+    const sf::Texture &getSpriteTexture() const;
+
+private:
+    FrameGeometry geometry;
+    // frame written by the spans, the back frame of geometry
+    FrameVertices *frame;
+    sf::Texture floorTexture;
+    sf::Texture ceilingTexture;
+    sf::Texture spriteTexture;
+    // size of the frame being written
+    int width;
+    int sliceWidth;
+};
 
 void handleKeys();
-void drawLines(sf::RenderWindow &window, sf::RenderStates);
-void drawMinimap(sf::RenderWindow &window);
+// draw a frame of the backend, with its textures
+void drawLines(sf::RenderWindow &window, sf::RenderStates, const SfmlBackend &backend, const FrameVertices &frame);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,343 @@
+#include "World.h"
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Lightmap.h"
+#include "Map.h"
+
+// every chunk in the stream radius has to fit, with room to evict
+static_assert(world_cache_chunks > (2 * world_keep_radius + 1) * (2 * world_keep_radius + 1), "world cache too small");
+
+// map chunks along each side of a dungeon chunk
+const int map_chunks_per_chunk = dungeon_chunk_size / chunk_size;
+// chunks asked for around the player
+const int world_stream_chunks = (2 * world_stream_radius + 1) * (2 * world_stream_radius + 1);
+
+// chunk generated off the main thread
+struct ChunkJob
+{
+    sf::Vector2i chunk;
+    bool valid;
+    char tiles[dungeon_chunk_size * dungeon_chunk_size];
+};
+
+// chunk in memory
+struct ChunkSlot
+{
+    sf::Vector2i chunk; // x -1 for free slots
+    long used;          // last update it was in the stream radius
+    char tiles[dungeon_chunk_size * dungeon_chunk_size];
+};
+
+static bool streaming = false;
+static unsigned worldSeed = 0;
+static long frame = 0;
+static long installed = 0;
+static long evicted = 0;
+static std::vector<ChunkSlot> slots;
+// slot of every chunk of the dungeon, -1 for the ones that aren't in memory
+static std::vector<int16_t> chunkSlots;
+// chunks that are being generated
+static std::vector<bool> chunkPending;
+
+// jobs move from idle to requested, to a generator, to finished and back to idle, all under mutex
+static std::mutex mutex;
+static std::condition_variable wake;
+static ChunkJob jobs[world_jobs];
+static std::vector<ChunkJob *> idle;
+static std::vector<ChunkJob *> requested;
+static std::vector<ChunkJob *> finished;
+static std::vector<std::thread> generators;
+static bool quit = false;
+
+static void stopGenerators()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    wake.notify_all();
+    for (std::thread &generator : generators)
+    {
+        generator.join();
+    }
+    generators.clear();
+    quit = false;
+}
+
+// the threads are stopped before the queues go away
+static struct GeneratorShutdown
+{
+    ~GeneratorShutdown()
+    {
+        stopGenerators();
+    }
+} shutdown;
+
+static void generate(ChunkJob &job)
+{
+    generateDungeonChunk(worldSeed, job.chunk.x, job.chunk.y, job.tiles);
+    job.valid = checkDungeonChunk(worldSeed, job.chunk.x, job.chunk.y, job.tiles);
+}
+
+static void runGenerator()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        wake.wait(lock, [] { return quit || !requested.empty(); });
+        if (quit)
+        {
+            return;
+        }
+        ChunkJob *job = requested.back();
+        requested.pop_back();
+        lock.unlock();
+        generate(*job);
+        lock.lock();
+        finished.push_back(job);
+    }
+}
+
+// where the tile is kept, so the map can change it too. NULL for chunks that aren't in memory.
+static char *getWorldTile(int x, int y)
+{
+    int slot = chunkSlots[(y >> dungeon_chunk_shift) * dungeon_chunks + (x >> dungeon_chunk_shift)];
+    if (slot < 0)
+    {
+        return NULL;
+    }
+    return &slots[slot].tiles[(y & dungeon_chunk_mask) * dungeon_chunk_size + (x & dungeon_chunk_mask)];
+}
+
+// write the solidity of a chunk that came or went to the map, published as one change so everything derived
+// from the map redoes it
+static void applyChunk(sf::Vector2i chunk, bool publish)
+{
+    const int x0 = chunk.x * dungeon_chunk_size;
+    const int y0 = chunk.y * dungeon_chunk_size;
+    beginTileEdits();
+    for (int map_y = 0; map_y < map_chunks_per_chunk; ++map_y)
+    {
+        for (int map_x = 0; map_x < map_chunks_per_chunk; ++map_x)
+        {
+            int left = x0 + map_x * chunk_size;
+            int top = y0 + map_y * chunk_size;
+            uint64_t bits = 0;
+            for (int i = 0; i < chunk_size * chunk_size; ++i)
+            {
+                if (getTileAttributes(getTile(left + (i & chunk_mask), top + (i >> chunk_shift))) & tile_solid)
+                {
+                    bits |= uint64_t(1) << i;
+                }
+            }
+            setChunkSolidity(left >> chunk_shift, top >> chunk_shift, bits, publish);
+        }
+    }
+    endTileEdits();
+}
+
+static int getDistance(sf::Vector2i a, sf::Vector2i b)
+{
+    return std::max(std::abs(a.x - b.x), std::abs(a.y - b.y));
+}
+
+// free slot, or the one of the least recently used chunk out of the keep radius. -1 if all are kept.
+static int findSlot(sf::Vector2i center, bool publish)
+{
+    int best = -1;
+    for (int i = 0; i < (int)slots.size(); ++i)
+    {
+        if (slots[i].chunk.x < 0)
+        {
+            return i;
+        }
+        if (getDistance(slots[i].chunk, center) > world_keep_radius && (best < 0 || slots[i].used < slots[best].used))
+        {
+            best = i;
+        }
+    }
+    if (best >= 0)
+    {
+        sf::Vector2i chunk = slots[best].chunk;
+        chunkSlots[chunk.y * dungeon_chunks + chunk.x] = -1;
+        slots[best].chunk = sf::Vector2i(-1, -1);
+        applyChunk(chunk, publish);
+        ++evicted;
+    }
+    return best;
+}
+
+static bool install(const ChunkJob &job, sf::Vector2i center, bool publish)
+{
+    int slot = findSlot(center, publish);
+    if (slot < 0)
+    {
+        return false;
+    }
+    ChunkSlot &target = slots[slot];
+    target.chunk = job.chunk;
+    target.used = frame;
+    if (job.valid)
+    {
+        memcpy(target.tiles, job.tiles, sizeof(target.tiles));
+    }
+    else
+    {
+        // the check printed why, it stays rock
+        memset(target.tiles, outside_tile, sizeof(target.tiles));
+    }
+    chunkSlots[job.chunk.y * dungeon_chunks + job.chunk.x] = slot;
+    chunkPending[job.chunk.y * dungeon_chunks + job.chunk.x] = false;
+    applyChunk(job.chunk, publish);
+    ++installed;
+    return true;
+}
+
+bool loadWorld(unsigned seed)
+{
+    stopGenerators();
+    worldSeed = seed;
+    frame = 0;
+    installed = 0;
+    evicted = 0;
+    slots.assign(world_cache_chunks, ChunkSlot{sf::Vector2i(-1, -1), 0, {}});
+    chunkSlots.assign(dungeon_chunks * dungeon_chunks, -1);
+    chunkPending.assign(dungeon_chunks * dungeon_chunks, false);
+    idle.clear();
+    requested.clear();
+    finished.clear();
+    for (ChunkJob &job : jobs)
+    {
+        idle.push_back(&job);
+    }
+    requested.reserve(world_jobs);
+    finished.reserve(world_jobs);
+    loadStreamedMap(dungeon_size, dungeon_size, getWorldTile);
+    streaming = true;
+
+    // the first chunks are generated right away, the game starts in them
+    sf::Vector2i center(dungeon_chunks / 2, dungeon_chunks / 2);
+    for (int y = center.y - world_stream_radius; y <= center.y + world_stream_radius; ++y)
+    {
+        for (int x = center.x - world_stream_radius; x <= center.x + world_stream_radius; ++x)
+        {
+            ChunkJob &job = jobs[0];
+            job.chunk = sf::Vector2i(x, y);
+            generate(job);
+            if (!job.valid)
+            {
+                return false;
+            }
+            install(job, center, false);
+        }
+    }
+
+    for (int i = 0; i < world_generator_threads; ++i)
+    {
+        generators.emplace_back(runGenerator);
+    }
+    return true;
+}
+
+void lightWorld()
+{
+    for (const ChunkSlot &slot : slots)
+    {
+        if (slot.chunk.x >= 0)
+        {
+            int x0 = slot.chunk.x * dungeon_chunk_size;
+            int y0 = slot.chunk.y * dungeon_chunk_size;
+            updateLightmapRect(x0, y0, x0 + dungeon_chunk_size - 1, y0 + dungeon_chunk_size - 1);
+        }
+    }
+}
+
+bool isWorldLoaded()
+{
+    return streaming;
+}
+
+sf::Vector2i getWorldSpawn()
+{
+    return findFloor(sf::Vector2i(dungeon_size / 2 + dungeon_chunk_size / 2, dungeon_size / 2 + dungeon_chunk_size / 2));
+}
+
+void updateWorld(sf::Vector2f position, sf::Vector2f direction)
+{
+    if (!streaming)
+    {
+        return;
+    }
+    ++frame;
+    sf::Vector2i center((int)position.x >> dungeon_chunk_shift, (int)position.y >> dungeon_chunk_shift);
+
+    // chunks in the stream radius are in use, the missing ones are wanted, closest to the point ahead first
+    sf::Vector2f ahead = (position + direction * (dungeon_chunk_size / 2.0f)) / (float)dungeon_chunk_size;
+    sf::Vector2i wanted[world_stream_chunks];
+    int wanted_count = 0;
+    for (int y = std::max(0, center.y - world_stream_radius); y <= std::min(dungeon_chunks - 1, center.y + world_stream_radius); ++y)
+    {
+        for (int x = std::max(0, center.x - world_stream_radius); x <= std::min(dungeon_chunks - 1, center.x + world_stream_radius); ++x)
+        {
+            int index = y * dungeon_chunks + x;
+            if (chunkSlots[index] >= 0)
+            {
+                slots[chunkSlots[index]].used = frame;
+            }
+            else if (!chunkPending[index])
+            {
+                wanted[wanted_count++] = sf::Vector2i(x, y);
+            }
+        }
+    }
+    auto distance = [&ahead](sf::Vector2i chunk) {
+        sf::Vector2f offset = sf::Vector2f(chunk.x + 0.5f, chunk.y + 0.5f) - ahead;
+        return offset.x * offset.x + offset.y * offset.y;
+    };
+    std::sort(wanted, wanted + wanted_count, [&](sf::Vector2i a, sf::Vector2i b) { return distance(a) < distance(b); });
+
+    // the generators only hold the lock to take and hand in jobs, if one does it's tried again next frame
+    std::unique_lock<std::mutex> lock(mutex, std::try_to_lock);
+    if (!lock)
+    {
+        return;
+    }
+    for (int installs = 0; installs < world_installs_per_frame && !finished.empty(); ++installs)
+    {
+        ChunkJob *job = finished.back();
+        if (!install(*job, center, true))
+        {
+            break;
+        }
+        finished.pop_back();
+        idle.push_back(job);
+    }
+    // generators take jobs from the back, so the most wanted goes in last
+    int asked = std::min(wanted_count, (int)idle.size());
+    for (int i = asked - 1; i >= 0; --i)
+    {
+        ChunkJob *job = idle.back();
+        idle.pop_back();
+        job->chunk = wanted[i];
+        chunkPending[wanted[i].y * dungeon_chunks + wanted[i].x] = true;
+        requested.push_back(job);
+    }
+    lock.unlock();
+    if (asked > 0)
+    {
+        wake.notify_all();
+    }
+}
+
+WorldStats getWorldStats()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    int resident = std::count_if(slots.begin(), slots.end(), [](const ChunkSlot &slot) { return slot.chunk.x >= 0; });
+    int pending = std::count(chunkPending.begin(), chunkPending.end(), true);
+    return WorldStats{resident, pending, installed, evicted};
+}
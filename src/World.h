@@ -0,0 +1,48 @@
+#ifndef World_hpp
+#define World_hpp
+#include <SFML/Graphics.hpp>
+#include "Dungeon.h"
+
+// The procedural dungeon as streamed map. Chunks around the player are generated on background threads,
+// the closest to the point ahead of the player first, and installed into the map between frames as changes
+// of its tiles, so the listeners of the map redo occupancy, light and the rest for them. Only
+// world_cache_chunks of them are kept, chunks that are needed evict the least recently used one out of
+// world_keep_radius, so memory doesn't grow with the distance walked. Chunks that aren't there are solid
+// rock. Evicted ones are generated again, the same way, when the player comes back.
+
+// chunks generated around the chunk of the player, in each direction
+const int world_stream_radius = 2;
+// chunks closer to the player are never evicted
+const int world_keep_radius = 4;
+// chunks kept in memory
+const int world_cache_chunks = 96;
+// generated chunks installed per frame at most, bounds the time a frame spends on them
+const int world_installs_per_frame = 2;
+// chunks generated or waiting to be installed at the same time
+const int world_jobs = 16;
+// threads generating chunks
+const int world_generator_threads = 2;
+
+struct WorldStats
+{
+    int resident;  // chunks in memory
+    int pending;   // chunks being generated or waiting to be installed
+    long installed; // chunks installed since the world was loaded
+    long evicted;
+};
+
+// load the dungeon of seed as streamed map, with the chunks around the spawn generated already.
+// Occupancy is built from the map afterwards, as for other maps, light with lightWorld().
+bool loadWorld(unsigned seed);
+// light the chunks in memory, after the lightmap was cleared. Baking all of the world would only find rock.
+void lightWorld();
+// is the loaded map a streamed world?
+bool isWorldLoaded();
+// floor tile near the middle of the world
+sf::Vector2i getWorldSpawn();
+// install the chunks generated since the last call, then ask for the missing ones around position,
+// ahead in direction first. Never waits for the generators.
+void updateWorld(sf::Vector2f position, sf::Vector2f direction);
+WorldStats getWorldStats();
+
+#endif
@@ -1,20 +1,75 @@
 #include <stdio.h>
+#include <math.h>
 #include <stdint.h>
 #include <SFML/Graphics.hpp>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
 #include "Window.h"
+#include "Minimap.h"
+#include "Framebuffer.h"
+#include "Raycast.h"
+#include "Occupancy.h"
+#include "Lightmap.h"
+#include "Allocations.h"
+#include "Entities.h"
+#include "Navigation.h"
+#include "Profiler.h"
+#include "Simulation.h"
+#include "World.h"
+#include "Doors.h"
+#include "Pipeline.h"
+#include "Sight.h"
+#include "Dda.h"
+#include "Movement.h"
 
 // time between FPS text refresh. FPS is smoothed out over this time
 const float fps_refresh_time = 0.05;
+// texture of the entities
+const char *sprite_texture_file = "data/texture/bush.png";
 
-int init()
+// files to write the profile of the frames to at exit, or NULL
+struct ProfileFiles
 {
-    // if the map is not correct, we can have segmentation faults. So check it.
-    if (!checkMap())
+    const char *csv;
+    const char *trace;
+};
+
+// collect the samples of the last frame, they are dropped when the rings of the threads fill up
+static void endProfileFrame()
+{
+#ifdef PROFILING
+    collectProfile();
+#endif
+}
+
+static bool writeProfile(const ProfileFiles &files)
+{
+#ifdef PROFILING
+    if (files.csv && !writeProfileCsv(files.csv))
     {
-        fprintf(stderr, "Map is invalid!\n");
-        return EXIT_FAILURE;
+        fprintf(stderr, "Cannot write %s!\n", files.csv);
+        return false;
     }
+    if (files.trace && !writeProfileTrace(files.trace))
+    {
+        fprintf(stderr, "Cannot write %s!\n", files.trace);
+        return false;
+    }
+#else
+    (void)files;
+#endif
+    return true;
+}
 
+// record: file to write the input of the session to at exit, or NULL
+// replay: input to play instead of the keyboard, the window closes when it ends, or NULL
+// pipeline: how frames are rendered, drawn and presented
+int init(const char *record, const InputLog *replay, PipelineMode pipeline_mode, const ProfileFiles &profile)
+{
     sf::Font font;
     if (!font.loadFromFile("data/font/opensans.ttf"))
     {
@@ -22,8 +77,13 @@ int init()
         return EXIT_FAILURE;
     }
 
+    sf::Image image;
     sf::Texture texture;
-    if (!texture.loadFromFile("data/texture/walls.png"))
+    // frame output for the window
+    SfmlBackend backend;
+    Minimap minimap;
+    if (!image.loadFromFile("data/texture/walls.png") || !texture.loadFromImage(image) || !backend.loadFloorTextures(image) ||
+        !backend.loadSpriteTexture(sprite_texture_file))
     {
         fprintf(stderr, "Cannot open texture!\n");
         return EXIT_FAILURE;
@@ -33,20 +93,43 @@ int init()
     sf::RenderStates state(&texture);
 
     // create window
-    sf::RenderWindow window(sf::VideoMode(screenWidth, screenHeight), "Rogue 3D");
-    window.setSize(sf::Vector2u(screenWidth, screenHeight));
+    sf::RenderWindow window(sf::VideoMode(getScreenWidth(), getScreenHeight()), "Rogue 3D");
+    window.setSize(sf::Vector2u(getScreenWidth(), getScreenHeight()));
 
     window.setFramerateLimit(1200);
     bool hasFocus = true;
 
     sf::Text fpsText("", font, 50); // text object for FPS counter
-    fpsText.setPosition(screenWidth - 250, 10);
+    fpsText.setPosition(getScreenWidth() - 250, 10);
     sf::Clock clock;                              // timer
-    char frameInfoString[sizeof("FPS: *****.*")]; // string buffer for frame information
+    char frameInfoString[sizeof("FPS: *****.*\n*****.** ms\n***** rays\nlag *****.* ms")]; // string buffer for frame information
+#ifdef PROFILING
+    sf::Text profileText("", font, 14); // percentiles of the stages
+    profileText.setPosition(getScreenWidth() - 330, 190);
+    char profileString[512];
+#endif
 
     float dt_counter = 0.0f;      // delta time for multiple frames, for calculating FPS smoothly
     int frame_counter = 0;        // counts frames for FPS calculation
     int64_t frame_time_micro = 0; // time needed to draw frames in microseconds
+    int64_t latency_micro = 0;    // time from reading the input to presenting it, of the new frames
+    int new_frames = 0;           // frames presented the first time
+
+    sf::Clock runtime; // input and present times
+    int64_t total_latency_micro = 0;
+    int64_t shown_input_micro = -1; // of the frame presented last, -1 before the first one
+    long presented = 0;
+    long shown = 0;   // frames presented the first time
+    long dropped = 0; // frames finished late and never presented
+    RenderPipeline pipeline(backend, pipeline_mode);
+
+    Simulation simulation;
+    InputLog recording;
+    simulation.setReplay(replay);
+    if (record)
+    {
+        simulation.setRecording(&recording);
+    }
 
     while (window.isOpen())
     {
@@ -58,11 +141,18 @@ int init()
         {
             float fps = (float)frame_counter / dt_counter;
             frame_time_micro /= frame_counter;
-            snprintf(frameInfoString, sizeof(frameInfoString), "FPS: %3.1f", fps);
+            snprintf(frameInfoString, sizeof(frameInfoString), "FPS: %3.1f\n%.2f ms\n%d rays\nlag %.1f ms", fps,
+                     frame_time_micro / 1000.0, getRayCount(), new_frames > 0 ? latency_micro / 1000.0 / new_frames : 0.0);
             fpsText.setString(frameInfoString);
+#ifdef PROFILING
+            formatProfile(profileString, sizeof(profileString));
+            profileText.setString(profileString);
+#endif
             dt_counter = 0.0f;
             frame_counter = 0;
             frame_time_micro = 0;
+            latency_micro = 0;
+            new_frames = 0;
         }
         dt_counter += dt;
         ++frame_counter;
@@ -87,34 +177,753 @@ int init()
             }
         }
 
-        // handle keyboard input
-        if (hasFocus)
+        // pipelined, the frame in flight renders from the game as it was started, only the player moves on
+        // until it's finished
+        bool ready;
+        {
+            PROFILE_SCOPE(Stage::Wait);
+            ready = pipeline.finish(pipeline_mode != PipelineMode::Drop);
+        }
+        if (!ready)
+        {
+            PROFILE_SCOPE(Stage::Input);
+            simulation.predict(dt, hasFocus ? pollKeyboard() : 0);
+        }
+        else
+        {
+            if (pipeline_mode != PipelineMode::Serial)
+            {
+                // the frame took its time on the producer, drawing the one before went on meanwhile
+                adaptRayCount(pipeline.getFrame().renderMicro / 1e6f);
+            }
+            // the player moved on while the frame rendered, a newer one is started right away instead
+            if (simulation.getPredictedTicks() > 0 && pipeline.drop())
+            {
+                ++dropped;
+            }
+            int64_t input_micro = runtime.getElapsedTime().asMicroseconds();
+            {
+                // handle keyboard input, move on to the current time in ticks
+                PROFILE_SCOPE(Stage::Input);
+                simulation.advance(dt, hasFocus ? pollKeyboard() : 0);
+                if (hasFocus)
+                {
+                    handleKeys();
+                }
+                // take in the chunks generated in the meantime
+                updateWorld(getPosition(), getDirection());
+            }
+            if (simulation.isReplayFinished())
+            {
+                window.close();
+            }
+            // render the view, serial it's the frame drawn below, pipelined it's drawn the next time around
+            pipeline.start(input_micro);
+        }
+
+        const PipelineFrame &frame = pipeline.getFrame();
+        {
+            PROFILE_SCOPE(Stage::Draw);
+            // clear przevious frame
+            window.clear();
+            // draw the view
+            drawLines(window, state, backend, *frame.vertices);
+            // draw fps
+            window.draw(fpsText);
+#ifdef PROFILING
+            window.draw(profileText);
+#endif
+        }
+        {
+            // draw minimap
+            PROFILE_SCOPE(Stage::Minimap);
+            minimap.draw(window, frame.vertices->rays, frame.camera.position);
+        }
+
+        int64_t frame_micro = clock.getElapsedTime().asMicroseconds();
+        frame_time_micro += frame_micro;
+        if (pipeline_mode == PipelineMode::Serial)
+        {
+            adaptRayCount(frame_micro / 1e6f);
+        }
+        {
+            PROFILE_SCOPE(Stage::Display);
+            window.display();
+        }
+        // the input shows when its frame is presented the first time
+        if (frame.inputMicro != shown_input_micro)
+        {
+            int64_t latency = runtime.getElapsedTime().asMicroseconds() - frame.inputMicro;
+            latency_micro += latency;
+            total_latency_micro += latency;
+            shown_input_micro = frame.inputMicro;
+            ++new_frames;
+            ++shown;
+        }
+        ++presented;
+        endProfileFrame();
+    }
+
+    // the frames drawn and how late they showed the input, to compare the modes of the pipeline
+    if (shown > 0)
+    {
+        float seconds = runtime.getElapsedTime().asSeconds();
+        printf("%ld frames presented, %.1f per second, %ld of them new, %.1f per second, %ld dropped, %.2f ms from input to "
+               "display (%s)\n",
+               presented, presented / seconds, shown, shown / seconds, dropped, total_latency_micro / 1000.0 / shown,
+               getPipelineName(pipeline_mode));
+    }
+
+    if (record && !recording.save(record))
+    {
+        fprintf(stderr, "Cannot write %s!\n", record);
+        return EXIT_FAILURE;
+    }
+    return writeProfile(profile) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// resident memory of the process in bytes, 0 where it can't be measured
+size_t getResidentMemory()
+{
+    size_t pages = 0;
+    FILE *statm = fopen("/proc/self/statm", "r");
+    if (statm)
+    {
+        if (fscanf(statm, "%*s %zu", &pages) != 1)
+            pages = 0;
+        fclose(statm);
+    }
+#ifndef _WIN32
+    return pages * sysconf(_SC_PAGESIZE);
+#else
+    return 0;
+#endif
+}
+
+// heap allocations made by rendering frames into backend, not counting the first two frames, which
+// fill both buffers of a double buffered backend for the first time
+size_t countFrameAllocations(RenderBackend &backend, int frames)
+{
+    render(backend);
+    render(backend);
+    size_t allocations = getHeapAllocations();
+    for (int i = 2; i < frames; ++i)
+    {
+        render(backend);
+    }
+    return getHeapAllocations() - allocations;
+}
+
+// turn on the spot at a few places around the player, at several rates, and check every frame's rays
+// against casting them all. Prints how many were taken over from the frame before.
+// returns: number of rays that differ
+int checkReuse(RenderBackend &backend)
+{
+    const float turn_rates[] = {0.0f, 0.001f, 0.01f, 0.05f, 0.3f, 2.0f}; // radians per frame
+    const sf::Vector2i offsets[] = {{0, 0}, {5, 0}, {0, 5}, {-5, -3}, {9, 9}};
+    const int frames_per_rate = 8;
+
+    PlayerState saved = getPlayerState();
+    sf::Vector2i start(saved.position);
+    long reused = 0;
+    long cast = 0;
+    int differ = 0;
+    for (sf::Vector2i offset : offsets)
+    {
+        sf::Vector2i tile = findFloor(start + offset);
+        setPosition(sf::Vector2f(tile.x + 0.5f, tile.y + 0.5f));
+        float angle = 0.3f;
+        for (float rate : turn_rates)
+        {
+            for (int i = 0; i < frames_per_rate; ++i)
+            {
+                angle += rate;
+                setDirection(sf::Vector2f(cos(angle), sin(angle)));
+                render(backend);
+                differ += checkRayReuse();
+                reused += getRenderStats().reusedRays;
+                cast += getRayCount();
+            }
+        }
+    }
+    setPlayerState(saved);
+    printf("reuse check: %ld of %ld rays taken over from the frame before, %d differ from casting them\n", reused, cast,
+           differ);
+    return differ;
+}
+
+static bool isSameGeometry(const std::vector<sf::Vertex> &a, const std::vector<sf::Vertex> &b)
+{
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](const sf::Vertex &u, const sf::Vertex &v) {
+               return u.position == v.position && u.color == v.color && u.texCoords == v.texCoords;
+           });
+}
+
+// render the view with the kernels of every feature set and with the generic kernels, into the framebuffer
+// and the window geometry, and compare the frames. Prints the result.
+// returns: number of feature sets where they differ
+int checkKernels(Framebuffer &framebuffer)
+{
+    const unsigned saved_features = getRenderFeatures();
+    SfmlBackend backend;
+    size_t bytes = (size_t)framebuffer.getWidth() * framebuffer.getHeight() * 4;
+    std::vector<sf::Uint8> pixels(bytes);
+    FrameVertices vertices;
+    int differ = 0;
+    for (unsigned features = 0; features < render_feature_sets; ++features)
+    {
+        setRenderFeatures(features);
+        setKernelSpecialization(true);
+        render(framebuffer);
+        render(backend);
+        memcpy(pixels.data(), framebuffer.getPixels(), bytes);
+        vertices = backend.getFrame();
+
+        setKernelSpecialization(false);
+        render(framebuffer);
+        render(backend);
+        const FrameVertices &frame = backend.getFrame();
+        differ += memcmp(pixels.data(), framebuffer.getPixels(), bytes) != 0 || !isSameGeometry(vertices.walls, frame.walls) ||
+                  !isSameGeometry(vertices.rows, frame.rows) || !isSameGeometry(vertices.rays, frame.rays);
+    }
+    setKernelSpecialization(true);
+    setRenderFeatures(saved_features);
+    printf("kernel check: %d of %u feature sets differ from the generic kernels\n", differ, render_feature_sets);
+    return differ;
+}
+
+// segment between the middles of two tiles stepped through tile by tile, the reference of the sight check.
+// No empty blocks are skipped and the tiles are read from the map, not from the solidity grid.
+// returns: true if no tile between the ends is solid
+static bool castSegment(sf::Vector2i from, sf::Vector2i to)
+{
+    DdaRay ray;
+    initRay(ray, sf::Vector2f(from.x + 0.5f, from.y + 0.5f), sf::Vector2f(to - from));
+    // every step crosses one of the grid lines between the tiles, the last one reaches the end
+    int lines = abs(to.x - from.x) + abs(to.y - from.y);
+    while (--lines > 0)
+    {
+        stepRay(ray);
+        if (getTileAttributes(getTile(ray.mapPos.x, ray.mapPos.y)) & tile_solid)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// compare the answers of isSegmentClear(), querySight() and canSee() around the player with stepping through
+// the segments tile by tile, from the sets, after a wall was set next to the player, which drops the sets
+// around it, and after building them again
+// returns: number of answers that differ
+static int compareSight(sf::Vector2i start, std::vector<SightQuery> &queries, std::vector<uint8_t> &visible)
+{
+    const int reach = 12; // of the tiles seen from, around the player
+    queries.clear();
+    for (int y = -reach; y <= reach; ++y)
+    {
+        for (int x = -reach; x <= reach; ++x)
         {
-            handleMove(dt);
-            handleKeys();
+            for (int row = -sight_radius; row <= sight_radius; ++row)
+            {
+                for (int column = -sight_radius; column <= sight_radius; ++column)
+                {
+                    sf::Vector2i from(start.x + x, start.y + y);
+                    queries.push_back(SightQuery{from, sf::Vector2i(from.x + column, from.y + row)});
+                }
+            }
         }
+    }
+    visible.resize(queries.size());
+    int looked = querySight(queries.data(), queries.size(), visible.data());
+    int differ = 0;
+    for (size_t i = 0; i < queries.size(); ++i)
+    {
+        const SightQuery &query = queries[i];
+        bool cast = castSegment(query.from, query.to);
+        differ += visible[i] != cast;
+        differ += (i % 97 == 0) && canSee(query.from, query.to) != cast;
+        differ += isSegmentClear(sf::Vector2f(query.from.x + 0.5f, query.from.y + 0.5f),
+                                 sf::Vector2f(query.to.x + 0.5f, query.to.y + 0.5f)) != cast;
+    }
+    printf("sight check: %zu queries, %d from the sets, %d differ from stepping them tile by tile\n", queries.size(),
+           looked, differ);
+    return differ;
+}
 
-        // render the view
-        render();
-        // clear przevious frame
-        window.clear();
-        // draw the view
-        drawLines(window, state);
-        // draw fps
-        window.draw(fpsText);
-        // clear lines to free memory
-        clearAllLines();
-        // draw minimap
-        drawMinimap(window);
+int checkSight()
+{
+    std::vector<SightQuery> queries;
+    std::vector<uint8_t> visible;
+    sf::Vector2i start(getPosition());
+    buildSight(start, 3);
+    int differ = compareSight(start, queries, visible);
 
-        frame_time_micro += clock.getElapsedTime().asMicroseconds();
-        window.display();
+    sf::Vector2i wall = findFloor(start + sf::Vector2i(2, 1));
+    char tile = getTile(wall.x, wall.y);
+    setTile(wall.x, wall.y, '1');
+    differ += compareSight(start, queries, visible);
+    buildSight(start, 3);
+    differ += compareSight(start, queries, visible);
+    setTile(wall.x, wall.y, tile);
+    clearSight();
+    return differ;
+}
+
+// walk across the streamed world, there and back on rows of chunks far enough apart that every row is new,
+// with all chunks around every step installed, and check the light of the chunks evicted behind is let go:
+// the pages stay within what the cached chunks can use, those and the chunks next to them, which walls
+// facing into the cache are on
+// returns: number of pages past that at the most
+int checkWorldMemory()
+{
+    const int leg_chunks = 100; // walked along each row
+    const int legs = 3;
+    const int map_chunks = dungeon_chunk_size / chunk_size + 2;
+    const int max_pages = world_cache_chunks * map_chunks * map_chunks;
+    PlayerState saved = getPlayerState();
+    sf::Vector2f position = getPosition();
+    int most = 0;
+    for (int leg = 0; leg < legs; ++leg)
+    {
+        const float direction = leg % 2 ? -1.0f : 1.0f;
+        for (int step = 0; step < leg_chunks * 2; ++step)
+        {
+            position.x = std::max(std::min(position.x + direction * dungeon_chunk_size / 2, dungeon_size - 1.0f), 0.0f);
+            WorldStats stats;
+            do
+            {
+                updateWorld(position, sf::Vector2f(direction, 0.0f));
+                usleep(100);
+                stats = getWorldStats();
+            } while (stats.pending > 0);
+            most = std::max(most, getLightPages());
+        }
+        position.y = std::min(position.y + (2 * world_keep_radius + 1) * dungeon_chunk_size, dungeon_size - 1.0f);
     }
+    setPlayerState(saved);
+    WorldStats stats = getWorldStats();
+    printf("world check: %ld chunks installed, %ld evicted, at most %d pages of light in memory, %d allowed\n",
+           stats.installed, stats.evicted, most, max_pages);
+    return std::max(most - max_pages, 0);
+}
 
+// does a box of size with its middle at position fit between the walls, inside of the map? The reference
+// of the movement check, every tile the box covers is tested one after another, as canMove() did before
+// moveBodies().
+static bool isBoxFreeByTiles(sf::Vector2f position, float size)
+{
+    sf::Vector2i upper_left(position - sf::Vector2f(size, size) / 2.0f);
+    sf::Vector2i lower_right(position + sf::Vector2f(size, size) / 2.0f);
+    if (upper_left.x < 0 || upper_left.y < 0 || lower_right.x >= getMapWidth() || lower_right.y >= getMapHeight())
+    {
+        return false;
+    }
+    SolidityCursor cursor;
+    for (int y = upper_left.y; y <= lower_right.y; ++y)
+    {
+        for (int x = upper_left.x; x <= lower_right.x; ++x)
+        {
+            if (cursor.isSolid(x, y))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// move random bodies with moveBodies() and compare where they end up with sliding each of them on its own,
+// x first and then y, as the player did. Boxes are smaller and larger than a tile, half of the bodies are
+// around the edges of the map and some of them outside of it, a quarter stand on eighths of a tile so
+// their boxes end on grid lines.
+// returns: number of bodies that end up elsewhere
+int checkMovement()
+{
+    const int bodies = 200000;
+    std::vector<float> x(bodies), y(bodies), velocity_x(bodies), velocity_y(bodies), size(bodies);
+    std::vector<float> out_x(bodies), out_y(bodies);
+    unsigned random = 1;
+    auto uniform = [&random](float low, float high) {
+        random = random * 1103515245 + 12345;
+        return low + (high - low) * ((random >> 8) & 0xffff) / 65535.0f;
+    };
+    const float width = getMapWidth();
+    const float height = getMapHeight();
+    for (int i = 0; i < bodies; ++i)
+    {
+        size[i] = i % 3 == 0 ? uniform(1.0f, 2.5f) : uniform(0.05f, 1.0f);
+        if (i % 2 == 0)
+        {
+            x[i] = uniform(0.0f, width);
+            y[i] = uniform(0.0f, height);
+        }
+        else
+        {
+            // along one of the edges, up to a few tiles inside or outside
+            float across = uniform(-3.0f, 3.0f);
+            bool vertical = i % 4 == 1;
+            float along = uniform(-3.0f, (vertical ? height : width) + 3.0f);
+            float edge = i % 8 < 4 ? across : (vertical ? width : height) + across;
+            x[i] = vertical ? edge : along;
+            y[i] = vertical ? along : edge;
+        }
+        if (i % 4 == 3)
+        {
+            x[i] = roundf(x[i] * 8.0f) / 8.0f;
+            y[i] = roundf(y[i] * 8.0f) / 8.0f;
+        }
+        velocity_x[i] = uniform(-1.5f, 1.5f);
+        velocity_y[i] = uniform(-1.5f, 1.5f);
+    }
+    BodyBatch batch{x.data(), y.data(), velocity_x.data(), velocity_y.data(), size.data(), out_x.data(), out_y.data(), bodies};
+    moveBodies(batch);
+
+    int differ = 0;
+    for (int i = 0; i < bodies; ++i)
+    {
+        sf::Vector2f position(x[i], y[i]);
+        if (isBoxFreeByTiles(sf::Vector2f(position.x + velocity_x[i], position.y), size[i]))
+        {
+            position.x += velocity_x[i];
+        }
+        if (isBoxFreeByTiles(sf::Vector2f(position.x, position.y + velocity_y[i]), size[i]))
+        {
+            position.y += velocity_y[i];
+        }
+        differ += position.x != out_x[i] || position.y != out_y[i];
+    }
+    printf("movement check: %d bodies moved with %s, %d end up elsewhere than sliding them one by one\n", bodies,
+           getRaycastSimdName(getRaycastSimd()), differ);
+    return differ;
+}
+
+// render frames into the software framebuffer, without opening a window. Every frame is one tick.
+// replay: input to play, it sets the number of frames, or NULL to render frames without input
+// dump: file to write the last frame to as PPM, or NULL
+// check_allocations: fail if frames after the first allocate, for the framebuffer and the window geometry
+// check_reuse: fail if rays taken over from the frame before differ from casting them
+// check_kernels: fail if the kernels of a feature set draw other frames than the generic ones
+// check_sight: fail if sight looked up in the sets differs from casting it
+// check_world: fail if the light of a streamed world grows with the distance walked
+// check_movement: fail if moving bodies together ends elsewhere than sliding them one by one
+int initHeadless(int frames, const InputLog *replay, const char *dump, bool check_allocations, bool check_reuse,
+                 bool check_kernels, bool check_sight, bool check_world, bool check_movement, const ProfileFiles &profile)
+{
+    Framebuffer framebuffer(getScreenWidth(), getScreenHeight());
+    if (!framebuffer.loadTexture("data/texture/walls.png") || !framebuffer.loadSpriteTexture(sprite_texture_file))
+    {
+        fprintf(stderr, "Cannot open texture!\n");
+        return EXIT_FAILURE;
+    }
+
+    Simulation simulation;
+    simulation.setReplay(replay);
+    if (replay)
+    {
+        frames = replay->getTicks();
+    }
+
+    sf::Clock clock;
+    int64_t frame_time_micro = 0; // time needed to render all frames in microseconds
+    int64_t tick_time_micro = 0;  // time needed to run the ticks of all frames
+    int64_t ray_steps = 0;        // DDA steps of all frames
+    int64_t lines_crossed = 0;    // grid lines crossed by them
+    int64_t sprites = 0;          // sprites in view
+    int64_t reused = 0;           // rays taken over from the frame before
+    int64_t rays = 0;             // rays of all frames
+    for (int i = 0; i < frames; ++i)
+    {
+        clock.restart();
+        simulation.advance(tick_time, 0);
+        updateWorld(getPosition(), getDirection());
+        tick_time_micro += clock.restart().asMicroseconds();
+        {
+            PROFILE_SCOPE(Stage::Render);
+            render(framebuffer);
+        }
+        int64_t frame_micro = clock.getElapsedTime().asMicroseconds();
+        frame_time_micro += frame_micro;
+        adaptRayCount(frame_micro / 1e6f);
+        endProfileFrame();
+        RenderStats stats = getRenderStats();
+        ray_steps += stats.raySteps;
+        lines_crossed += stats.linesCrossed;
+        sprites += stats.sprites;
+        reused += stats.reusedRays;
+        rays += stats.rays;
+    }
+    printf("%d frames, %.1f us per frame (%d threads, %s), %.1f MB resident\n", frames, frames > 0 ? (double)frame_time_micro / frames : 0.0,
+           getRenderThreads(), getRaycastSimdName(getRaycastSimd()), getResidentMemory() / (1024.0 * 1024.0));
+    if (frames > 0)
+    {
+        printf("%.0f ray steps per frame, %.0f saved by empty space skipping\n", (double)ray_steps / frames,
+               (double)(lines_crossed - ray_steps) / frames);
+        printf("%dx%d pixels, %.0f rays per frame, %.0f of them taken over from the frame before\n", getScreenWidth(),
+               getScreenHeight(), (double)rays / frames, (double)reused / frames);
+        printf("%.1f of %d sprites in view per frame\n", (double)sprites / frames, getEntityCount());
+        printf("%.1f us per tick, %d agents\n", (double)tick_time_micro / frames, getAgentCount());
+    }
+    if (isWorldLoaded())
+    {
+        WorldStats world = getWorldStats();
+        printf("%d chunks in memory, %d pending, %ld installed, %ld evicted\n", world.resident, world.pending,
+               world.installed, world.evicted);
+    }
+#ifdef PROFILING
+    char profileString[512];
+    formatProfile(profileString, sizeof(profileString));
+    printf("%s\n", profileString);
+#endif
+    if (!writeProfile(profile))
+    {
+        return EXIT_FAILURE;
+    }
+
+    if (dump && !framebuffer.savePPM(dump))
+    {
+        fprintf(stderr, "Cannot write %s!\n", dump);
+        return EXIT_FAILURE;
+    }
+
+    if (check_kernels && checkKernels(framebuffer) > 0)
+    {
+        fprintf(stderr, "Kernels draw other frames than the generic ones!\n");
+        return EXIT_FAILURE;
+    }
+
+    if (check_reuse && checkReuse(framebuffer) > 0)
+    {
+        fprintf(stderr, "Rays taken over from the frame before are wrong!\n");
+        return EXIT_FAILURE;
+    }
+
+    if (check_sight && checkSight() > 0)
+    {
+        fprintf(stderr, "Sight from the sets differs from casting it!\n");
+        return EXIT_FAILURE;
+    }
+
+    if (check_world && !isWorldLoaded())
+    {
+        fprintf(stderr, "--check-world needs --generate\n");
+        return EXIT_FAILURE;
+    }
+    if (check_world && checkWorldMemory() > 0)
+    {
+        fprintf(stderr, "Light of evicted chunks stays in memory!\n");
+        return EXIT_FAILURE;
+    }
+
+    if (check_movement && checkMovement() > 0)
+    {
+        fprintf(stderr, "Bodies moved together end up elsewhere!\n");
+        return EXIT_FAILURE;
+    }
+
+    if (check_allocations)
+    {
+        SfmlBackend backend;
+        size_t allocations = countFrameAllocations(framebuffer, frames) + countFrameAllocations(backend, frames);
+        printf("%zu heap allocations in steady state frames\n", allocations);
+        if (allocations > 0)
+        {
+            fprintf(stderr, "Frames allocate memory!\n");
+            return EXIT_FAILURE;
+        }
+    }
     return EXIT_SUCCESS;
 }
 
-int main()
+int main(int argc, char **argv)
 {
-    init();
+    bool headless = false;
+    int frames = 1;
+    const char *dump = NULL;
+    bool check_allocations = false;
+    bool check_reuse = false;
+    bool check_kernels = false;
+    bool check_sight = false;
+    bool check_world = false;
+    bool check_movement = false;
+    int threads = 0; // render threads, 0 is one per hardware thread
+    const char *map = NULL;     // level to load instead of worldMap
+    const char *convert = NULL; // file to write the level to as binary map
+    ProfileFiles profile = {NULL, NULL};
+    const char *record = NULL; // file to write the input to
+    const char *replay = NULL; // file to play the input from
+    int entities = 32;         // entities scattered over the map
+    int agents = 0;            // entities following the player
+    bool generate = false;     // stream the procedural dungeon instead of loading a level
+    unsigned seed = 0;         // of the dungeon
+    int width = default_screen_width; // of the frames
+    int height = default_screen_height;
+    int rays = 0;              // cast per frame, 0 for one per screen column
+    PipelineMode pipeline = PipelineMode::Wait; // of the window
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--headless") == 0)
+            headless = true;
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+            frames = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--dump") == 0 && i + 1 < argc)
+            dump = argv[++i];
+        else if (strcmp(argv[i], "--check-alloc") == 0)
+            check_allocations = true;
+        else if (strcmp(argv[i], "--check-reuse") == 0)
+            check_reuse = true;
+        else if (strcmp(argv[i], "--check-kernels") == 0)
+            check_kernels = true;
+        else if (strcmp(argv[i], "--check-sight") == 0)
+            check_sight = true;
+        else if (strcmp(argv[i], "--check-world") == 0)
+            check_world = true;
+        else if (strcmp(argv[i], "--check-movement") == 0)
+            check_movement = true;
+        else if (strcmp(argv[i], "--no-shading") == 0)
+            setRenderFeatures(getRenderFeatures() & ~render_shading);
+        else if (strcmp(argv[i], "--no-fog") == 0)
+            setRenderFeatures(getRenderFeatures() & ~render_fog);
+        else if (strcmp(argv[i], "--no-lighting") == 0)
+            setRenderFeatures(getRenderFeatures() & ~render_lighting);
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--scalar") == 0)
+            setRaycastSimd(RaycastSimd::Scalar);
+        else if (strcmp(argv[i], "--no-skip") == 0)
+            setEmptySpaceSkipping(false);
+        else if (strcmp(argv[i], "--no-reuse") == 0)
+            setRayReuse(false);
+        else if (strcmp(argv[i], "--resolution") == 0 && i + 1 < argc && sscanf(argv[i + 1], "%dx%d", &width, &height) == 2)
+            ++i;
+        else if (strcmp(argv[i], "--rays") == 0 && i + 1 < argc)
+            rays = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--frame-budget") == 0 && i + 1 < argc)
+            setFrameBudget(atof(argv[++i]) / 1000.0f);
+        else if (strcmp(argv[i], "--pipeline") == 0 && i + 1 < argc && parsePipelineMode(argv[i + 1], pipeline))
+            ++i;
+        else if (strcmp(argv[i], "--map") == 0 && i + 1 < argc)
+            map = argv[++i];
+        else if (strcmp(argv[i], "--generate") == 0 && i + 1 < argc)
+        {
+            generate = true;
+            seed = strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--convert") == 0 && i + 1 < argc)
+            convert = argv[++i];
+        else if (strcmp(argv[i], "--entities") == 0 && i + 1 < argc)
+            entities = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--agents") == 0 && i + 1 < argc)
+            agents = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+            record = argv[++i];
+        else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+            replay = argv[++i];
+        else if (strcmp(argv[i], "--profile-csv") == 0 && i + 1 < argc)
+            profile.csv = argv[++i];
+        else if (strcmp(argv[i], "--profile-trace") == 0 && i + 1 < argc)
+            profile.trace = argv[++i];
+        else
+        {
+            fprintf(stderr, "usage: %s [--map file.r3m|file.txt [--convert out.r3m]] [--generate SEED] [--entities N] [--agents N] [--threads N] [--scalar] [--no-skip] [--no-reuse] "
+                            "[--resolution WxH] [--rays N] [--frame-budget MS] [--pipeline serial|wait|drop] [--no-shading] [--no-fog] [--no-lighting] "
+                            "[--record input.txt] [--replay input.txt] [--headless [--frames N] [--dump out.ppm] [--check-alloc] [--check-reuse] [--check-kernels] [--check-sight] [--check-world] [--check-movement]] "
+                            "[--profile-csv out.csv] [--profile-trace out.json]\n",
+                    argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    setResolution(width, height);
+    if (rays > 0)
+    {
+        setRayCount(rays);
+    }
+
+    if (headless && record)
+    {
+        fprintf(stderr, "--record needs the window, there is no input without it\n");
+        return EXIT_FAILURE;
+    }
+    InputLog replayLog;
+    if (replay && !replayLog.load(replay))
+    {
+        return EXIT_FAILURE;
+    }
+
+    if (profile.csv || profile.trace)
+    {
+#ifdef PROFILING
+        setProfileRecording(true);
+#else
+        fprintf(stderr, "Built without profiling, use make profile!\n");
+        return EXIT_FAILURE;
+#endif
+    }
+
+    sf::Clock clock;
+    bool loaded;
+    if (generate)
+        loaded = loadWorld(seed);
+    else if (!map)
+        loaded = loadMap();
+    else if (strlen(map) > 4 && strcmp(map + strlen(map) - 4, ".r3m") == 0)
+        loaded = loadBinaryMap(map);
+    else
+        loaded = loadAsciiMap(map);
+    int64_t load_time_micro = clock.getElapsedTime().asMicroseconds();
+
+    // if the map is not correct, we can have segmentation faults. So check it.
+    // The chunks of the dungeon are checked one by one when they are generated.
+    if (!loaded || (!generate && !checkMap()))
+    {
+        fprintf(stderr, "Map is invalid!\n");
+        return EXIT_FAILURE;
+    }
+    printf("map %dx%d loaded in %.1f ms, checked in %.1f ms, %.1f MB resident\n", getMapWidth(), getMapHeight(),
+           load_time_micro / 1000.0, (clock.getElapsedTime().asMicroseconds() - load_time_micro) / 1000.0,
+           getResidentMemory() / (1024.0 * 1024.0));
+
+    if (convert)
+    {
+        return saveBinaryMap(convert) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    clock.restart();
+    buildOccupancy();
+    int64_t occupancy_time_micro = clock.getElapsedTime().asMicroseconds();
+    if (generate)
+    {
+        clearLightmap();
+        lightWorld();
+    }
+    else
+    {
+        bakeLightmap();
+    }
+    printf("occupancy built in %.1f ms, light baked in %.1f ms\n", occupancy_time_micro / 1000.0,
+           (clock.getElapsedTime().asMicroseconds() - occupancy_time_micro) / 1000.0);
+
+    clearEntities();
+    scatterEntities(entities, 1);
+    clearAgents();
+    scatterAgents(agents, 2);
+    clearDoors();
+
+    if (generate)
+    {
+        setPosition(sf::Vector2f(getWorldSpawn()) + sf::Vector2f(0.5f, 0.5f));
+    }
+    // start on a floor tile, levels other than worldMap don't have one at the default position
+    sf::Vector2i start = findFloor(sf::Vector2i(getPosition()));
+    if (start != sf::Vector2i(getPosition()))
+    {
+        setPosition(sf::Vector2f(start) + sf::Vector2f(0.5f, 0.5f));
+    }
+
+    setRenderThreads(threads);
+
+    const InputLog *input = replay ? &replayLog : NULL;
+    return headless ? initHeadless(frames, input, dump, check_allocations, check_reuse, check_kernels, check_sight, check_world, check_movement, profile) : init(record, input, pipeline, profile);
 }